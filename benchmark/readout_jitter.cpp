@@ -0,0 +1,146 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Measures how much a periodic, latency sensitive application is perturbed by lo2s.
+ *
+ * Starts one thread per CPU, pinned to it, that wakes up on an absolute period and records how
+ * late each wakeup is. The percentiles of the lateness over all threads are printed at the end.
+ * Compare the tail latencies of e.g.
+ *
+ *   readout_jitter
+ *   lo2s -a --readout-phase sync -- readout_jitter
+ *   lo2s -a --readout-phase stagger -- readout_jitter
+ *
+ * Usage: readout_jitter [PERIOD_US [DURATION_S]] (defaults: 1000 us, 10 s)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+}
+
+static std::uint64_t to_ns(const struct timespec& ts)
+{
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static struct timespec from_ns(std::uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000ull;
+    ts.tv_nsec = ns % 1000000000ull;
+    return ts;
+}
+
+static void measure(int cpu, std::uint64_t period_ns, std::uint64_t duration_ns,
+                    std::vector<std::uint64_t>& lateness)
+{
+    cpu_set_t cpumask;
+    CPU_ZERO(&cpumask);
+    CPU_SET(cpu, &cpumask);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpumask), &cpumask);
+
+    lateness.reserve(duration_ns / period_ns);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    auto next = to_ns(now) + period_ns;
+    auto end = next + duration_ns;
+
+    for (; next < end; next += period_ns)
+    {
+        auto deadline = from_ns(next);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) != 0)
+        {
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        lateness.push_back(to_ns(now) - next);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t period_us = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+    std::uint64_t duration_s = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10;
+    if (period_us == 0 || duration_s == 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [PERIOD_US [DURATION_S]]\n";
+        return EXIT_FAILURE;
+    }
+
+    cpu_set_t cpus;
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+
+    std::vector<int> cpu_ids;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &cpus))
+        {
+            cpu_ids.push_back(cpu);
+        }
+    }
+
+    std::vector<std::vector<std::uint64_t>> lateness(cpu_ids.size());
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < cpu_ids.size(); i++)
+    {
+        threads.emplace_back(measure, cpu_ids[i], period_us * 1000, duration_s * 1000000000ull,
+                             std::ref(lateness[i]));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<std::uint64_t> all;
+    for (const auto& l : lateness)
+    {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    if (all.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    std::sort(all.begin(), all.end());
+
+    auto percentile = [&all](double p) {
+        return all[std::min(all.size() - 1, static_cast<std::size_t>(p * all.size()))] / 1000.0;
+    };
+
+    std::cout << "wakeups: " << all.size() << " on " << cpu_ids.size() << " CPUs\n";
+    std::cout << "lateness [us]: p50 " << percentile(0.5) << ", p99 " << percentile(0.99)
+              << ", p99.9 " << percentile(0.999) << ", p99.99 " << percentile(0.9999) << ", max "
+              << all.back() / 1000.0 << "\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+# Copyright (c) 2020, Technische Universität Dresden, Germany
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+#    and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+#    and the following disclaimer in the documentation and/or other materials provided with the
+#    distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+#    or promote products derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+# FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+# THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Find libdw (and libelf) from elfutils, used for unwinding call stacks with the DWARF CFI
+if (Libdw_LIBRARIES AND Libdw_INCLUDE_DIRS)
+  set (Libdw_FIND_QUIETLY TRUE)
+endif()
+
+find_path(Libdw_INCLUDE_DIRS elfutils/libdwfl.h
+        PATHS ENV C_INCLUDE_PATH ENV CPATH
+        PATH_SUFFIXES include)
+
+find_library(Libdw_LIBRARY NAMES dw
+        HINTS ENV LIBRARY_PATH ENV LD_LIBRARY_PATH)
+find_library(Libdw_ELF_LIBRARY NAMES elf
+        HINTS ENV LIBRARY_PATH ENV LD_LIBRARY_PATH)
+
+if(Libdw_LIBRARY AND Libdw_ELF_LIBRARY)
+    set(Libdw_LIBRARIES ${Libdw_LIBRARY} ${Libdw_ELF_LIBRARY})
+endif()
+
+include (FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(Libdw DEFAULT_MSG
+        Libdw_LIBRARIES
+        Libdw_INCLUDE_DIRS)
+
+if(Libdw_FOUND)
+    add_library(libdw INTERFACE)
+    target_link_libraries(libdw INTERFACE ${Libdw_LIBRARIES})
+    target_include_directories(libdw SYSTEM INTERFACE ${Libdw_INCLUDE_DIRS})
+    add_library(Libdw::Libdw ALIAS libdw)
+endif()
+
+mark_as_advanced(Libdw_INCLUDE_DIRS Libdw_LIBRARY Libdw_ELF_LIBRARY)
@@ -42,6 +42,32 @@ enum class MonitorType
     CPU_SET
 };
 
+enum class CallGraphMode
+{
+    // Call chains of the kernel, which follow the frame pointers
+    FRAME_POINTER,
+    // Registers and a copy of the user stack, unwound with the DWARF CFI of the binaries
+    DWARF,
+    // The call stack kept in the last branch records of the CPU
+    LBR
+};
+
+enum class CounterGroupRotation
+{
+    // Let the kernel multiplex all counter groups round-robin
+    MULTIPLEX,
+    // Keep the first counter group on the PMU, only the others are multiplexed
+    PIN_FIRST
+};
+
+enum class ReadoutPhase
+{
+    // All readout timers expire at the same time
+    SYNC,
+    // The expirations of the readout timers are spread over the interval
+    STAGGER
+};
+
 struct Config
 {
     // General
@@ -52,25 +78,45 @@ struct Config
     bool quiet;
     // Optional features
     std::vector<std::string> tracepoint_events;
+    bool wakeup_latency;
+    bool syscalls;
+    std::chrono::nanoseconds syscall_min_duration;
     std::vector<std::string> perf_events;
 #ifdef HAVE_X86_ADAPT
     std::vector<std::string> x86_adapt_knobs;
 #endif
     // OTF2
     std::string trace_path;
+    std::string stats_file;
     // perf
     std::size_t mmap_pages;
     bool exclude_kernel;
+    bool reader_stats;
+    bool monitor_stats;
     // Instruction sampling
     bool sampling;
     std::uint64_t sampling_period;
+    bool sampling_use_frequency;
+    std::uint64_t sampling_frequency;
+    std::vector<std::string> sampling_group_events;
+    bool memory_sampling;
+    bool adaptive_period;
     std::string sampling_event;
     bool enable_cct;
+    CallGraphMode call_graph_mode;
+    std::uint32_t stack_dump_size;
     bool suppress_ip;
     bool disassemble;
+    // Off-CPU call stacks
+    bool off_cpu;
+    // Reordering of out-of-order perf records
+    std::chrono::nanoseconds reorder_window;
+    std::size_t reorder_capacity;
     // Interval monitors
     std::chrono::nanoseconds read_interval;
     std::chrono::nanoseconds perf_read_interval;
+    std::size_t reader_threads;
+    ReadoutPhase readout_phase;
     // Metrics
     bool metric_use_frequency;
 
@@ -79,6 +125,11 @@ struct Config
 
     std::string metric_leader;
     bool standard_metrics;
+    CounterGroupRotation metric_group_rotation;
+    std::vector<std::string> derived_metrics;
+    bool derived_metrics_only;
+    bool metric_use_rdpmc;
+    bool metric_counting;
 
     // time synchronization
     bool use_clockid;
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace lo2s
+{
+
+/* Histogram of latencies with power-of-two buckets, cheap enough to update for every event.
+ *
+ * Bucket 0 counts zero latencies, bucket i counts the latencies in [2^(i-1), 2^i).
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr std::size_t num_buckets = 65;
+
+    void add(std::uint64_t value)
+    {
+        buckets_[bucket(value)]++;
+        count_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (std::size_t i = 0; i < num_buckets; i++)
+        {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    // Upper bound of the bucket that holds the q-quantile, at most the maximum
+    std::uint64_t quantile(double q) const
+    {
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < num_buckets; i++)
+        {
+            seen += buckets_[i];
+            if (seen > 0 && seen >= q * count_)
+            {
+                return std::min(upper_bound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    // Exclusive upper bound of bucket i, saturated for the last bucket
+    static std::uint64_t upper_bound(std::size_t i)
+    {
+        return i >= 64 ? UINT64_MAX : std::uint64_t(1) << i;
+    }
+
+    const std::array<std::uint64_t, num_buckets>& buckets() const
+    {
+        return buckets_;
+    }
+
+    std::uint64_t count() const
+    {
+        return count_;
+    }
+
+    std::uint64_t sum() const
+    {
+        return sum_;
+    }
+
+    std::uint64_t max() const
+    {
+        return max_;
+    }
+
+private:
+    static std::size_t bucket(std::uint64_t value)
+    {
+        return value == 0 ? 0 : 64 - __builtin_clzll(value);
+    }
+
+    std::array<std::uint64_t, num_buckets> buckets_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t max_ = 0;
+};
+} // namespace lo2s
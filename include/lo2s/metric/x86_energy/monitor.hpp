@@ -30,7 +30,7 @@ public:
             const otf2::definition::system_tree_node& stn);
 
 protected:
-    void monitor(int fd) override;
+    void monitor() override;
     void initialize_thread() override;
 
     std::string group() const override
@@ -23,7 +23,9 @@
 #include <lo2s/monitor/fwd.hpp>
 #include <lo2s/monitor/poll_monitor.hpp>
 
+#include <lo2s/perf/counter/counting_writer.hpp>
 #include <lo2s/perf/counter/cpu_writer.hpp>
+#include <lo2s/perf/counter/userspace_writer.hpp>
 #include <lo2s/perf/sample/writer.hpp>
 
 #ifndef USE_PERF_RECORD_SWITCH
@@ -43,7 +45,7 @@ public:
     CpuMonitor(int cpuid, MainMonitor& parent);
 
 public:
-    void monitor(int fd) override;
+    void monitor() override;
 
     std::string group() const override
     {
@@ -57,6 +59,8 @@ private:
     int cpu_;
 
     std::unique_ptr<perf::counter::CpuWriter> counter_writer_;
+    std::unique_ptr<perf::counter::UserspaceWriter> userspace_counter_writer_;
+    std::unique_ptr<perf::counter::CountingWriter> counting_writer_;
     std::unique_ptr<perf::sample::Writer> sample_writer_;
 #ifndef USE_PERF_RECORD_SWITCH
     perf::tracepoint::SwitchWriter switch_writer_;
@@ -28,6 +28,7 @@ namespace monitor
 class ThreadedMonitor;
 
 class PollMonitor;
+class ReaderPool;
 
 class ThreadMonitor;
 class CoreMonitor;
@@ -30,6 +30,7 @@
 #endif
 #include <lo2s/mmap.hpp>
 #include <lo2s/monitor/tracepoint_monitor.hpp>
+#include <lo2s/monitor/uncore_monitor.hpp>
 #include <lo2s/process_info.hpp>
 #include <lo2s/trace/trace.hpp>
 
@@ -66,6 +67,7 @@ protected:
     std::map<pid_t, ProcessInfo> process_infos_;
     metric::plugin::Metrics metrics_;
     std::vector<std::unique_ptr<TracepointMonitor>> tracepoint_monitors_;
+    std::vector<std::unique_ptr<UncoreMonitor>> uncore_monitors_;
 #ifdef HAVE_X86_ADAPT
     std::unique_ptr<metric::x86_adapt::Metrics> x86_adapt_metrics_;
 #endif
@@ -28,47 +28,92 @@
 #include <lo2s/trace/fwd.hpp>
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <vector>
 
-extern "C"
-{
-#include <poll.h>
-}
-
 namespace lo2s
 {
 namespace monitor
 {
+/* Waits on the file descriptors of its readers with epoll.
+ *
+ * Each registered fd carries a pointer to its handler in the epoll_data, so a wakeup only touches
+ * the readers whose fds are ready. On every expiration of the read interval timer and when
+ * stopping, all handlers are called, followed by monitor().
+ *
+ * With --reader-threads, the monitor has no thread of its own, but is served by the ReaderPool.
+ */
 class PollMonitor : public ThreadedMonitor
 {
 public:
     PollMonitor(trace::Trace& trace, const std::string& name,
                 std::chrono::nanoseconds read_interval);
 
+    ~PollMonitor();
+
+    void start() override;
     void stop() override;
 
 protected:
     void run() override;
-    void monitor() override;
 
-    void add_fd(int fd);
+    // Called on every timer expiration and when stopping, for readers that have no fd
+    void monitor() override
+    {
+    }
+
+    // Calls read whenever fd becomes readable. fd is watched edge-triggered, so read has to drain
+    // everything that is available.
+    void add_fd(int fd, std::function<void()> read);
 
-    virtual void monitor([[maybe_unused]] int fd){};
+    // May also be called from within a handler, read is not called anymore afterwards, not even
+    // for events of fd that are already pending
+    void remove_fd(int fd);
 
-    struct pollfd& stop_pfd()
+    bool running() const
     {
-        return pfds_[0];
+        return thread_.joinable() || pooled_;
     }
 
-    struct pollfd& timer_pfd()
+    // Whether the monitor is served by the ReaderPool rather than its own thread
+    bool pooled() const
     {
-        return pfds_[1];
+        return pooled_;
     }
 
     Pipe stop_pipe_;
 
 private:
-    std::vector<pollfd> pfds_;
+    friend class ReaderPool;
+
+    struct Handler
+    {
+        int fd;
+        std::function<void()> read;
+        bool removed = false;
+    };
+
+    void add_handler(Handler& handler, std::uint32_t events);
+
+    void read_all();
+
+    // Waits up to timeout milliseconds for events and handles them. Returns false once the monitor
+    // has been stopped.
+    bool dispatch(int timeout);
+
+    int epoll_fd_;
+    int timer_fd_ = -1;
+    bool pooled_ = false;
+
+    Handler stop_handler_;
+    Handler timer_handler_;
+
+    std::map<int, std::unique_ptr<Handler>> handlers_;
+    // Handlers removed during a dispatch have to outlive it, they are freed at its end
+    std::vector<std::unique_ptr<Handler>> removed_handlers_;
 };
 } // namespace monitor
 } // namespace lo2s
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/monitor/fwd.hpp>
+#include <lo2s/pipe.hpp>
+#include <lo2s/trace/fwd.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace lo2s
+{
+namespace monitor
+{
+
+/* A small set of threads that serves all PollMonitors (--reader-threads), instead of one thread
+ * per monitor.
+ *
+ * Each monitor keeps its own epoll instance with its readers, timer and stop pipe. The epoll fds
+ * of all monitors are in turn registered with EPOLLONESHOT in one shared epoll instance, which all
+ * workers wait on. Whichever worker is idle takes the next monitor with pending data, drains it,
+ * and re-arms it. A burst on one CPU's buffers is thereby picked up by any idle worker, while a
+ * single monitor is never read by two workers at the same time.
+ *
+ * The initialize_thread() of the monitors is not run, they are read on whichever CPU of its
+ * package the worker runs on. Hence config.cpp rejects --metric-rdpmc, which only works on the CPU
+ * of the counters, and --monitor-stats, as the overhead of a worker is shared by its monitors.
+ */
+class ReaderPool
+{
+public:
+    static ReaderPool& instance();
+
+    ReaderPool(const ReaderPool&) = delete;
+    ReaderPool& operator=(const ReaderPool&) = delete;
+
+    // Workers are spread round-robin over the packages and pinned to their CPUs
+    void start(trace::Trace& trace, std::size_t num_workers);
+
+    // All monitors must have been stopped before
+    void stop();
+
+    bool running() const
+    {
+        return !workers_.empty();
+    }
+
+    void add(PollMonitor& monitor);
+
+    // Blocks until monitor has handled its stop request and has been finalized
+    void wait_finished(PollMonitor& monitor);
+
+private:
+    class Worker;
+
+    ReaderPool();
+    ~ReaderPool();
+
+    // Returns the next monitor with pending data, or nullptr once the pool is stopped
+    PollMonitor* wait();
+    void dispatch(PollMonitor& monitor);
+
+    int epoll_fd_ = -1;
+    Pipe stop_pipe_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex finished_mutex_;
+    std::condition_variable finished_cv_;
+    std::set<PollMonitor*> finished_;
+};
+} // namespace monitor
+} // namespace lo2s
@@ -23,8 +23,13 @@
 #include <lo2s/monitor/fwd.hpp>
 #include <lo2s/monitor/poll_monitor.hpp>
 
+#include <lo2s/perf/counter/counting_writer.hpp>
 #include <lo2s/perf/counter/process_writer.hpp>
+#ifdef USE_PERF_RECORD_SWITCH
+#include <lo2s/perf/sample/off_cpu_writer.hpp>
+#endif
 #include <lo2s/perf/sample/writer.hpp>
+#include <lo2s/perf/tracepoint/syscall_writer.hpp>
 
 #include <array>
 #include <chrono>
@@ -68,7 +73,7 @@ public:
 
     void initialize_thread() override;
     void finalize_thread() override;
-    void monitor(int fd) override;
+    void monitor() override;
 
     std::string group() const override
     {
@@ -82,7 +87,12 @@ private:
     cpu_set_t affinity_mask_;
 
     std::unique_ptr<perf::sample::Writer> sample_writer_;
+#ifdef USE_PERF_RECORD_SWITCH
+    std::unique_ptr<perf::sample::OffCpuWriter> off_cpu_writer_;
+#endif
+    std::unique_ptr<perf::tracepoint::SyscallWriter> syscall_writer_;
     std::unique_ptr<perf::counter::ProcessWriter> counter_writer_;
+    std::unique_ptr<perf::counter::CountingWriter> counting_writer_;
 };
 } // namespace monitor
 } // namespace lo2s
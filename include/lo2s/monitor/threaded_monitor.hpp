@@ -23,6 +23,11 @@
 
 #include <lo2s/trace/fwd.hpp>
 
+#include <otf2xx/chrono/chrono.hpp>
+#include <otf2xx/event/metric.hpp>
+#include <otf2xx/writer/local.hpp>
+
+#include <optional>
 #include <string>
 #include <thread>
 
@@ -69,12 +74,24 @@ protected:
     {
     }
 
+    // Must be called by the monitoring thread whenever it wakes up
+    void count_wakeup();
+
 protected:
     std::thread thread_;
     trace::Trace& trace_;
     std::string name_;
 
     std::size_t num_wakeups_;
+
+private:
+    void write_overhead();
+
+    // With --monitor-stats, the CPU time, wakeups and perf records of the monitoring thread are
+    // recorded as metrics, at most once per --readout-interval
+    otf2::writer::local* overhead_writer_ = nullptr;
+    std::optional<otf2::event::metric> overhead_event_;
+    otf2::chrono::time_point last_overhead_write_;
 };
 } // namespace monitor
 } // namespace lo2s
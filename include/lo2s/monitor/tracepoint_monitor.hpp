@@ -26,7 +26,6 @@
 #include <lo2s/monitor/poll_monitor.hpp>
 #include <lo2s/trace/trace.hpp>
 
-#include <map>
 #include <memory>
 
 namespace lo2s
@@ -40,7 +39,6 @@ public:
     TracepointMonitor(trace::Trace& trace, int cpuid);
 
 private:
-    void monitor(int fd) override;
     void initialize_thread() override;
     void finalize_thread() override;
 
@@ -51,7 +49,7 @@ private:
 
 private:
     int cpu_;
-    std::map<int, std::unique_ptr<perf::tracepoint::Writer>> perf_writers_;
+    std::unique_ptr<perf::tracepoint::Writer> perf_writer_;
 };
 } // namespace monitor
 } // namespace lo2s
@@ -0,0 +1,62 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/monitor/poll_monitor.hpp>
+#include <lo2s/perf/counter/uncore_writer.hpp>
+#include <lo2s/trace/trace.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace lo2s
+{
+namespace monitor
+{
+
+/**
+ * Records the requested uncore events of all PMUs that have the given CPU in their cpumask.
+ * The metrics are scoped to the unit the PMU counts for instead of being counted once per CPU:
+ * the package of that CPU if the cpumask has one CPU of each package, the whole system if it has
+ * a single CPU, and that CPU itself otherwise.
+ */
+class UncoreMonitor : public PollMonitor
+{
+public:
+    UncoreMonitor(trace::Trace& trace, int cpuid);
+
+private:
+    void monitor() override;
+    void initialize_thread() override;
+    void finalize_thread() override;
+
+    std::string group() const override
+    {
+        return "perf::UncoreMonitor";
+    }
+
+private:
+    int cpu_;
+    std::vector<std::unique_ptr<perf::counter::UncoreWriter>> writers_;
+};
+} // namespace monitor
+} // namespace lo2s
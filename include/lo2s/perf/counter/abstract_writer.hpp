@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <lo2s/perf/counter/metric_writer.hpp>
 #include <lo2s/perf/counter/reader.hpp>
 #include <lo2s/perf/time/converter.hpp>
 #include <lo2s/trace/trace.hpp>
@@ -42,10 +43,7 @@ public:
 
 protected:
     time::Converter time_converter_;
-    otf2::writer::local& writer_;
-    otf2::definition::metric_instance metric_instance_;
-    // XXX this should depend here!
-    otf2::event::metric metric_event_;
+    MetricWriter metric_writer_;
 };
 } // namespace counter
 } // namespace perf
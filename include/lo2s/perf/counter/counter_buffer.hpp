@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -58,6 +59,8 @@ class CounterBuffer
 public:
     CounterBuffer(const CounterBuffer&) = delete;
     void operator=(const CounterBuffer&) = delete;
+    // The double buffers are heap allocated, so moving keeps current_ and previous_ valid
+    CounterBuffer(CounterBuffer&&) = default;
 
     CounterBuffer(std::size_t ncounters);
 
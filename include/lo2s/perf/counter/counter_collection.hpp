@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <lo2s/perf/counter/derived_metric.hpp>
 #include <lo2s/perf/event_description.hpp>
 
 #include <vector>
@@ -35,6 +36,10 @@ struct CounterCollection
 {
     EventDescription leader;
     std::vector<EventDescription> counters;
+    std::vector<DerivedMetric> derived_metrics;
+    // Events of uncore PMUs, which are not recorded per CPU or thread, but once per unit in the
+    // cpumask of their PMU, see monitor::UncoreMonitor
+    std::vector<EventDescription> uncore_counters;
 };
 
 const CounterCollection& requested_counters();
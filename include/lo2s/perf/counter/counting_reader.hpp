@@ -0,0 +1,67 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/counter/counter_collection.hpp>
+#include <lo2s/perf/counter/reader.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+extern "C"
+{
+#include <sys/types.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+// Sets up the same counter groups as Reader, but the leaders only count and never sample. Instead
+// of reading records from a ring buffer, the groups are read with a single read() per group
+// whenever the owning monitor wants to, i.e. on its readout timer.
+class CountingReader
+{
+public:
+    CountingReader(pid_t tid, int cpuid, const CounterCollection& counter_collection,
+                   bool enable_on_exec);
+    ~CountingReader();
+
+    CountingReader(const CountingReader&) = delete;
+    CountingReader& operator=(const CountingReader&) = delete;
+
+protected:
+    // Updates the accumulated values in the order leader, counters, time_enabled, time_running
+    void read(std::vector<double>& values);
+
+private:
+    std::vector<CounterGroup> groups_;
+    std::unique_ptr<std::byte[]> read_buffer_;
+    std::size_t read_buffer_size_ = 0;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
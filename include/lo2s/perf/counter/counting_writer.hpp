@@ -0,0 +1,59 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/counter/counting_reader.hpp>
+#include <lo2s/perf/counter/metric_writer.hpp>
+#include <lo2s/time/time.hpp>
+#include <lo2s/trace/trace.hpp>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+class CountingWriter : public CountingReader
+{
+public:
+    CountingWriter(pid_t tid, int cpuid, otf2::writer::local& writer,
+                   otf2::definition::metric_instance metric_instance, bool enable_on_exec)
+    : CountingReader(tid, cpuid, requested_counters(), enable_on_exec),
+      metric_writer_(writer, metric_instance)
+    {
+    }
+
+    void read()
+    {
+        // There is no perf timestamp for read(), but with --clockid the perf clock is our clock
+        auto tp = lo2s::time::now();
+        CountingReader::read(metric_writer_.values());
+        metric_writer_.write(tp);
+    }
+
+private:
+    MetricWriter metric_writer_;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -38,6 +38,7 @@ public:
                                          parent.trace().cpu_switch_writer(cpuid).location()),
           false)
     {
+        init_stats(parent.trace(), writer.location());
     }
 };
 } // namespace counter
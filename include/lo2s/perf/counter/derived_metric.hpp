@@ -0,0 +1,101 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+/* A metric computed from the counter values of each readout, e.g. "ipc={instructions}/{cycles}".
+ *
+ * The expression is compiled once into a flat stack bytecode. Operands are numbers, the names of
+ * the recorded events (written as {event-name}, or without braces if the name is a plain
+ * identifier) and parentheses. Supported operators are + - * / and unary minus. Events refer to
+ * the (scaled) number of events since the previous readout.
+ */
+class DerivedMetric
+{
+public:
+    class InvalidExpression : public std::runtime_error
+    {
+    public:
+        InvalidExpression(const std::string& definition, const std::string& what)
+        : std::runtime_error("invalid derived metric '" + definition + "': " + what)
+        {
+        }
+    };
+
+    // Parses NAME=EXPRESSION. The index of a name in variables is the index of its value in the
+    // values passed to evaluate().
+    DerivedMetric(const std::string& definition, const std::vector<std::string>& variables);
+
+    const std::string& name() const
+    {
+        return name_;
+    }
+
+    const std::string& expression() const
+    {
+        return expression_;
+    }
+
+    // Division by zero yields 0, so that idle intervals do not end up as NaN in the trace
+    double evaluate(const std::vector<double>& values) const;
+
+    static constexpr std::size_t max_stack_depth = 32;
+
+private:
+    enum class OpCode
+    {
+        CONSTANT,
+        VARIABLE,
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        NEGATE
+    };
+
+    struct Instruction
+    {
+        OpCode op;
+        double constant;
+        std::size_t variable;
+    };
+
+    friend class ExpressionParser;
+
+    std::string name_;
+    std::string expression_;
+    std::vector<Instruction> code_;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,71 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/trace/trace.hpp>
+
+#include <otf2xx/chrono/time_point.hpp>
+#include <otf2xx/event/metric.hpp>
+
+#include <vector>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+// Writes the accumulated values of the requested counters, followed by the derived metrics, as
+// one event of the perf metric class.
+class MetricWriter
+{
+public:
+    MetricWriter(otf2::writer::local& writer, otf2::definition::metric_instance metric_instance);
+
+    // Accumulated values in the order of the metric class, i.e. leader, counters, time_enabled,
+    // time_running. To be filled by the readers before each write().
+    std::vector<double>& values()
+    {
+        return current_values_;
+    }
+
+    // Derived metrics are only recomputed if update_derived is set, otherwise the previous results
+    // are repeated
+    void write(otf2::chrono::time_point tp, bool update_derived = true);
+
+private:
+    void update_derived_metrics();
+
+    otf2::writer::local& writer_;
+    otf2::definition::metric_instance metric_instance_;
+    otf2::event::metric metric_event_;
+
+    std::vector<double> current_values_;
+    // current_values_ at the previous evaluation of the derived metrics
+    std::vector<double> previous_values_;
+    std::vector<double> deltas_;
+    std::vector<double> derived_values_;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -23,6 +23,7 @@
 
 #include <lo2s/perf/counter/counter_buffer.hpp>
 #include <lo2s/perf/counter/counter_collection.hpp>
+#include <lo2s/perf/event_description.hpp>
 #include <lo2s/perf/event_reader.hpp>
 
 #include <vector>
@@ -39,10 +40,50 @@ namespace perf
 namespace counter
 {
 
-// This class is concerned with setting up and reading out perf counters in a group.
-// This group has a group leader event, which triggers a readout of the other
-// events every --metric-count occurences. The value is then written into a memory-mapped
-// ring buffer, which we read out routinely to get the counter values.
+// Retries without kernel events if kernel.perf_event_paranoid requires it, see
+// exclude_kernel_fallback
+int perf_try_event_open(struct perf_event_attr* perf_attr, pid_t tid, int cpu, int group_fd,
+                        unsigned long flags, bool uncore);
+
+// Opens a counting (non-sampling) event, read_format contains the enabled and running times
+int open_counter(pid_t tid, int cpuid, const EventDescription& desc, int group_fd);
+
+// A set of counters that can be scheduled on the PMU at the same time. Each group has its own
+// copy of the leader event, which triggers a readout of the other events of the group.
+struct CounterGroup
+{
+    CounterGroup(int leader_fd, std::size_t ncounters) : leader_fd(leader_fd), buffer(ncounters + 1)
+    {
+    }
+
+    int leader_fd;
+    // The sample id of the leader, used to tell the records of the groups apart
+    uint64_t id = 0;
+    std::vector<int> counter_fds;
+    // Position of each counter of this group in the requested CounterCollection
+    std::vector<std::size_t> indices;
+    CounterBuffer buffer;
+};
+
+// Opens the counters of counter_collection in as many groups as needed, each with its own copy of
+// the leader. If mmap_pages is not 0, the leaders sample with PERF_SAMPLE_READ into a ring buffer
+// of that size, otherwise they only count. The groups are not enabled yet, unless enable_on_exec
+// is set.
+std::vector<CounterGroup> open_counter_groups(pid_t tid, int cpuid,
+                                              const CounterCollection& counter_collection,
+                                              bool enable_on_exec, std::size_t mmap_pages);
+void close_counter_groups(std::vector<CounterGroup>& groups);
+void enable_counter_groups(const std::vector<CounterGroup>& groups);
+
+// Gathers the accumulated values of all groups in the order of the perf metric class, i.e. leader,
+// counters, time_enabled, time_running
+void collect_counter_values(const std::vector<CounterGroup>& groups, std::vector<double>& values);
+
+// This class is concerned with setting up and reading out perf counters in groups.
+// The requested counters are partitioned into as many groups as needed to fit onto the hardware.
+// The leader of each group triggers a readout of the other events every --metric-count
+// occurences. The values of all groups are written into the memory-mapped ring buffer of the
+// first group, which we read out routinely to get the counter values.
 template <class T>
 class Reader : public EventReader<T>
 {
@@ -52,26 +93,21 @@ public:
     struct RecordSampleType
     {
         struct perf_event_header header;
+        uint64_t id;
         uint64_t time;
         struct GroupReadFormat v;
     };
 
     ~Reader()
     {
-        for (int fd : counter_fds_)
-        {
-            if (fd != -1)
-            {
-                ::close(fd);
-            }
-        }
-        ::close(group_leader_fd_);
+        close_counter_groups(groups_);
     }
 
+    // All groups sample into the ring buffer of the first one
+    void redirect_outputs();
+
 protected:
-    int group_leader_fd_;
-    std::vector<int> counter_fds_;
-    CounterBuffer counter_buffer_;
+    std::vector<CounterGroup> groups_;
 };
 
 } // namespace counter
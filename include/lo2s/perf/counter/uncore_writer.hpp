@@ -0,0 +1,89 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/counter/counter_collection.hpp>
+#include <lo2s/perf/counter/counting_reader.hpp>
+#include <lo2s/time/time.hpp>
+
+#include <otf2xx/chrono/time_point.hpp>
+#include <otf2xx/event/metric.hpp>
+#include <otf2xx/writer/local.hpp>
+
+#include <vector>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+// Counts the events of one uncore PMU on a CPU of its cpumask, which stands for the whole unit
+// (usually the package). The events are read on the readout timer and written as one event of
+// the metric class of the PMU, see trace::Trace::uncore_metric_class.
+class UncoreWriter : public CountingReader
+{
+public:
+    UncoreWriter(int cpuid, const CounterCollection& counter_collection,
+                 otf2::writer::local& writer, otf2::definition::metric_instance metric_instance)
+    : CountingReader(-1, cpuid, counter_collection, false), writer_(writer),
+      metric_event_(otf2::chrono::genesis(), metric_instance),
+      values_(counter_collection.counters.size() + 3, 0)
+    {
+        scales_.push_back(counter_collection.leader.scale);
+        for (const auto& counter : counter_collection.counters)
+        {
+            scales_.push_back(counter.scale);
+        }
+    }
+
+    void read()
+    {
+        auto tp = lo2s::time::now();
+        CountingReader::read(values_);
+
+        metric_event_.timestamp(tp);
+        otf2::event::metric::values& values = metric_event_.raw_values();
+        std::size_t index = 0;
+        for (; index < scales_.size(); index++)
+        {
+            values[index] = values_[index] * scales_[index];
+        }
+        // time_enabled and time_running
+        values[index] = values_[index];
+        index++;
+        values[index] = values_[index];
+
+        writer_.write(metric_event_);
+    }
+
+private:
+    otf2::writer::local& writer_;
+    otf2::event::metric metric_event_;
+
+    std::vector<double> values_;
+    std::vector<double> scales_;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/counter/counter_buffer.hpp>
+#include <lo2s/perf/counter/counter_collection.hpp>
+
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+// Reads CPU-wide counters without any interrupt or ring buffer. Each counter, including the
+// metric leader, is counted on its own. If the kernel allows it (cap_user_rdpmc) and the calling
+// thread runs on the monitored CPU, the counters are read from userspace with rdpmc using the
+// self-monitoring protocol of the perf mmap page. Otherwise, each counter is read with read().
+class UserspaceReader
+{
+public:
+    UserspaceReader(int cpuid, const CounterCollection& counter_collection);
+    ~UserspaceReader();
+
+    UserspaceReader(const UserspaceReader&) = delete;
+    UserspaceReader& operator=(const UserspaceReader&) = delete;
+
+protected:
+    // Updates the accumulated values in the order leader, counters, time_enabled, time_running
+    void read(std::vector<double>& values);
+
+private:
+    struct UserspaceCounter
+    {
+        UserspaceCounter(int fd, struct perf_event_mmap_page* page) : fd(fd), page(page), buffer(1)
+        {
+        }
+
+        int fd;
+        struct perf_event_mmap_page* page;
+        CounterBuffer buffer;
+    };
+
+    bool read_rdpmc(const struct perf_event_mmap_page* page, GroupReadFormat& result);
+    void read_syscall(int fd, GroupReadFormat& result);
+
+    int cpuid_;
+    std::vector<UserspaceCounter> counters_;
+    bool warned_fallback_ = false;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
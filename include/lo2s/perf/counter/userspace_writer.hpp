@@ -0,0 +1,59 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/monitor/main_monitor.hpp>
+#include <lo2s/perf/counter/metric_writer.hpp>
+#include <lo2s/perf/counter/userspace_reader.hpp>
+#include <lo2s/time/time.hpp>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+class UserspaceWriter : public UserspaceReader
+{
+public:
+    UserspaceWriter(int cpuid, otf2::writer::local& writer, monitor::MainMonitor& parent)
+    : UserspaceReader(cpuid, requested_counters()),
+      metric_writer_(writer, parent.trace().metric_instance(
+                                 parent.trace().perf_metric_class(), writer.location(),
+                                 parent.trace().cpu_switch_writer(cpuid).location()))
+    {
+    }
+
+    void read()
+    {
+        auto tp = lo2s::time::now();
+        UserspaceReader::read(metric_writer_.values());
+        metric_writer_.write(tp);
+    }
+
+private:
+    MetricWriter metric_writer_;
+};
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -21,8 +21,11 @@
 
 #pragma once
 
+#include <set>
 #include <string>
 
+#include <cstdint>
+
 extern "C"
 {
 #include <linux/perf_event.h>
@@ -49,11 +52,26 @@ struct EventDescription
     {
     }
 
+    // Uncore PMUs can not tell user from kernel and refuse any exclude_* flag
+    bool uncore() const
+    {
+        return !cpus.empty();
+    }
+
     std::string name;
     perf_type_id type;
     std::uint64_t config;
     std::uint64_t config1;
     Availability availability;
+
+    // Only set for events read from sysfs
+    std::string pmu;
+    // The CPUs in the cpumask of the PMU. Uncore PMUs count for a whole package (or another unit
+    // shared by several cores) and list one CPU per unit here. Empty for core PMUs.
+    std::set<uint32_t> cpus;
+    // The raw count multiplied by scale is in unit, see events/<name>.scale and .unit in sysfs
+    double scale = 1.0;
+    std::string unit = "#";
 };
 } // namespace perf
 } // namespace lo2s
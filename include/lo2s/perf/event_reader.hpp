@@ -26,15 +26,23 @@
 #include <lo2s/error.hpp>
 #include <lo2s/log.hpp>
 #include <lo2s/mmap.hpp>
+#include <lo2s/perf/reader_stats.hpp>
+#include <lo2s/perf/ring_budget.hpp>
 #include <lo2s/platform.hpp>
+#include <lo2s/summary.hpp>
 #include <lo2s/util.hpp>
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cinttypes>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <typeinfo>
 
 extern "C"
 {
@@ -49,6 +57,15 @@ namespace lo2s
 {
 namespace perf
 {
+/* Set while the calling thread reads the readers it is about to close. This last readout does not
+ * adapt the size of the ring buffers anymore.
+ */
+inline bool& thread_final_readout()
+{
+    thread_local bool final_readout = false;
+    return final_readout;
+}
+
 template <class T>
 class EventReader
 {
@@ -137,13 +154,44 @@ public:
         // struct sample_id sample_id;
     };
 
+    // The size of the ring buffer is taken from the RingBudget when the reader is created, so
+    // that the subclass can set attr.wakeup_watermark before opening the event
+    EventReader(RingKind kind)
+    : mmap_pages_(RingBudget::instance().reserve(kind)), initial_mmap_pages_(mmap_pages_)
+    {
+    }
+
+    EventReader(EventReader&& other)
+    : total_samples(other.total_samples), throttle_samples(other.throttle_samples),
+      lost_samples(other.lost_samples), mmap_pages_(other.mmap_pages_),
+      initial_mmap_pages_(other.initial_mmap_pages_), stats_name_(std::move(other.stats_name_)),
+      stats_(std::move(other.stats_)), fd_(other.fd_), base(other.base)
+    {
+        other.mmap_pages_ = 0;
+        other.base = nullptr;
+        other.lost_samples = 0;
+    }
+
     ~EventReader()
     {
+        if (mmap_pages_ != 0)
+        {
+            summary().record_reader(stats_name_.empty() ? typeid(CRTP).name() : stats_name_,
+                                    total_samples, lost_samples, throttle_samples);
+        }
         if (lost_samples > 0)
         {
             Log::warn() << "Lost a total of " << lost_samples << " samples in event_reader<"
                         << typeid(CRTP).name() << ">.";
         }
+        if (base != nullptr)
+        {
+            munmap(base, (mmap_pages_ + 1) * get_page_size());
+        }
+        if (mmap_pages_ != 0)
+        {
+            RingBudget::instance().release(mmap_pages_);
+        }
     }
 
 protected:
@@ -151,12 +199,8 @@ protected:
     {
         fd_ = fd;
 
-        mmap_pages_ = config().mmap_pages;
-
-        base = mmap(NULL, (mmap_pages_ + 1) * get_page_size(), PROT_READ | PROT_WRITE, MAP_SHARED,
-                    fd, 0);
-        // Should not be necessary to check for nullptr, but we've seen it!
-        if (base == MAP_FAILED || base == nullptr)
+        base = try_mmap(mmap_pages_);
+        if (base == nullptr)
         {
             Log::error() << "mapping memory for recording events failed. You can try "
                             "to decrease the buffer size with the -m flag, or try to increase "
@@ -166,9 +210,96 @@ protected:
         }
     }
 
+    /* Replaces the mapping of the ring buffer by one with new_pages data pages. The buffer must
+     * have been read completely. Records written between the last read and the new mapping are
+     * dropped by the kernel, without a PERF_RECORD_LOST.
+     *
+     * If the new mapping fails, the old size is mapped again. If even that fails, the reader is
+     * dead: it keeps its event open, but does not read anything anymore.
+     */
+    bool remap(std::size_t new_pages)
+    {
+        if (!RingBudget::instance().resize(mmap_pages_, new_pages))
+        {
+            return false;
+        }
+
+        // The kernel detaches the ring buffer from the event, and every event redirected into it,
+        // once the last mapping is gone. Only then the event can be mapped with another size.
+        munmap(base, (mmap_pages_ + 1) * get_page_size());
+        base = try_mmap(new_pages);
+        if (base != nullptr)
+        {
+            mmap_pages_ = new_pages;
+            redirect_outputs_after_remap();
+            return true;
+        }
+
+        Log::warn() << "resizing perf ring buffer of event_reader<" << typeid(CRTP).name()
+                    << "> to " << new_pages << " pages failed: " << std::strerror(errno);
+        RingBudget::instance().resize(new_pages, mmap_pages_);
+        base = try_mmap(mmap_pages_);
+        if (base != nullptr)
+        {
+            redirect_outputs_after_remap();
+        }
+        else
+        {
+            Log::error() << "restoring the perf ring buffer of event_reader<"
+                         << typeid(CRTP).name() << "> failed: " << std::strerror(errno)
+                         << ". No further events are recorded by it.";
+        }
+        return false;
+    }
+
+    /* Writers call this with the location they write the records to. The location names the
+     * reader in the --stats-file. With --reader-stats, the state of the ring buffer is also
+     * recorded after each readout.
+     */
+    void init_stats(trace::Trace& trace, const otf2::definition::location& location)
+    {
+        stats_name_ = location.name().str();
+        if (config().reader_stats)
+        {
+            stats_ = std::make_unique<ReaderStats>(trace, location);
+        }
+    }
+
+    /* Subclasses that redirect further events into this ring buffer with
+     * PERF_EVENT_IOC_SET_OUTPUT have to do so again after a remap().
+     */
+    void redirect_outputs()
+    {
+    }
+
+    /* Called once the records of a readout were handled, before their memory in the ring buffer
+     * is handed back to the kernel. Subclasses that still point to records have to copy them here.
+     * This includes the copy of a record that spans the wrap-around of the ring buffer, which is
+     * only valid until the next readout.
+     */
+    void records_handled()
+    {
+    }
+
+    /* Called after each readout with the fill level the ring buffer had and the time the readout
+     * took, e.g. to adapt the sampling rate to the load.
+     */
+    void readout_done([[maybe_unused]] double fill,
+                      [[maybe_unused]] std::chrono::nanoseconds duration)
+    {
+    }
+
 public:
     void read()
     {
+        if (base == nullptr)
+        {
+            // Dead after a failed remap()
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
         auto cur_head = data_head();
         auto cur_tail = data_tail();
 
@@ -177,6 +308,8 @@ public:
         /* if the ring buffer has been filled to fast, we skip the current entries*/
         auto diff = cur_head - cur_tail;
         assert(cur_tail <= cur_head);
+        double fill = std::min(1.0, static_cast<double>(diff) / data_size());
+        bool complete = true;
         if (diff > data_size())
         {
             Log::error() << "perf ring buffer overflow. "
@@ -265,6 +398,7 @@ public:
                 cur_tail += event_header_p->size;
                 if (stop)
                 {
+                    complete = false;
                     break;
                 }
             }
@@ -276,11 +410,107 @@ public:
                                 "Increase the buffer size or the sampling period";
             }
             Log::trace() << "read " << read_samples << " samples.";
+
+            auto& totals = thread_readout_totals();
+            totals.records += read_samples;
+            totals.bytes += cur_tail - data_tail();
         }
+        static_cast<CRTP*>(this)->records_handled();
         data_tail(cur_tail);
+
+        std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+        if (stats_)
+        {
+            stats_->write(lost_samples, throttle_samples, fill, data_size(), duration);
+        }
+
+        static_cast<CRTP*>(this)->readout_done(fill, duration);
+
+        if (complete && !thread_final_readout())
+        {
+            adapt_mmap(fill);
+        }
     }
 
 private:
+    // Returns nullptr on failure, with errno set
+    void* try_mmap(std::size_t pages)
+    {
+        auto mapping = mmap(NULL, (pages + 1) * get_page_size(), PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd_, 0);
+        // Should not be necessary to check for nullptr, but we've seen it!
+        if (mapping == MAP_FAILED || mapping == nullptr)
+        {
+            return nullptr;
+        }
+        return mapping;
+    }
+
+    // Runs in read(), where nothing may throw
+    void redirect_outputs_after_remap()
+    {
+        try
+        {
+            static_cast<CRTP*>(this)->redirect_outputs();
+        }
+        catch (std::exception& e)
+        {
+            Log::warn() << "event_reader<" << typeid(CRTP).name()
+                        << "> lost events after resizing its ring buffer: " << e.what();
+        }
+    }
+
+    /* With automatically sized buffers (no -m), grow a ring buffer that ran (nearly) full or lost
+     * records since the last readout, and give the memory back once it stays mostly empty.
+     *
+     * Buffers never shrink below their initial size: attr.wakeup_watermark was set for that size
+     * when the event was opened and can not be changed. The kernel limits it to the size of the
+     * buffer, so a smaller buffer would only wake us up once it is full.
+     */
+    void adapt_mmap(double fill)
+    {
+        static constexpr double full_fill = 0.9;
+        static constexpr double empty_fill = 0.1;
+        static constexpr std::size_t max_growth = 16;
+        static constexpr std::size_t empty_readouts_before_shrink = 100;
+
+        if (config().mmap_pages != 0 || base == nullptr)
+        {
+            return;
+        }
+
+        bool lost = lost_samples != lost_samples_at_last_readout_;
+        lost_samples_at_last_readout_ = lost_samples;
+
+        if ((fill >= full_fill || lost) && mmap_pages_ < initial_mmap_pages_ * max_growth)
+        {
+            empty_readouts_ = 0;
+            if (remap(mmap_pages_ * 2))
+            {
+                Log::info() << "Increased perf ring buffer of event_reader<"
+                            << typeid(CRTP).name() << "> to " << mmap_pages_ << " pages.";
+            }
+            return;
+        }
+
+        if (fill < empty_fill && mmap_pages_ > initial_mmap_pages_)
+        {
+            if (++empty_readouts_ >= empty_readouts_before_shrink)
+            {
+                empty_readouts_ = 0;
+                if (remap(mmap_pages_ / 2))
+                {
+                    Log::debug() << "Decreased perf ring buffer of event_reader<"
+                                 << typeid(CRTP).name() << "> to " << mmap_pages_ << " pages.";
+                }
+            }
+        }
+        else
+        {
+            empty_readouts_ = 0;
+        }
+    }
+
     const struct perf_event_mmap_page* header() const
     {
         return (const struct perf_event_mmap_page*)base;
@@ -353,8 +583,15 @@ protected:
     size_t mmap_pages_ = 0;
 
 private:
+    size_t initial_mmap_pages_ = 0;
+    int64_t lost_samples_at_last_readout_ = 0;
+    std::size_t empty_readouts_ = 0;
+
+    std::string stats_name_;
+    std::unique_ptr<ReaderStats> stats_;
+
     int fd_;
-    void* base;
+    void* base = nullptr;
     std::byte event_copy[PERF_SAMPLE_MAX_SIZE] __attribute__((aligned(8)));
 };
 } // namespace perf
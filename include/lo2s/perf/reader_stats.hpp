@@ -0,0 +1,70 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/trace/fwd.hpp>
+
+#include <otf2xx/definition/location.hpp>
+#include <otf2xx/definition/metric_instance.hpp>
+#include <otf2xx/event/metric.hpp>
+#include <otf2xx/writer/local.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace lo2s
+{
+namespace perf
+{
+
+struct ReadoutTotals
+{
+    std::uint64_t records = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Records (and their size) read by all perf readers of the calling thread so far
+ReadoutTotals& thread_readout_totals();
+
+/* Records the state of a perf ring buffer after each readout (--reader-stats): the number of lost
+ * and throttle records so far, how full the buffer was and how long the readout took.
+ *
+ * The metrics are written to a location of their own, with the location of the reader as scope.
+ * Their timestamps are taken when the readout is done, which may be later than the records the
+ * next readout writes to the location of the reader.
+ */
+class ReaderStats
+{
+public:
+    ReaderStats(trace::Trace& trace, const otf2::definition::location& location);
+
+    void write(std::uint64_t lost, std::uint64_t throttled, double fill, std::size_t size,
+               std::chrono::nanoseconds duration);
+
+private:
+    otf2::writer::local& writer_;
+    otf2::definition::metric_instance metric_instance_;
+    otf2::event::metric event_;
+};
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,203 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+
+/* perf does not guarantee that the records in a ring buffer are ordered by their timestamp, e.g.
+ * PEBS or multiplexed events may be delivered slightly late.
+ *
+ * This class keeps a small window of records, ordered in a min-heap by their timestamp. A record
+ * is only released once it is older than the newest record seen so far minus the horizon, or if
+ * the window is full. Within a readout, the window only points to the records in the ring buffer.
+ * Most records leave the window during the readout they were read in and are never copied. Only
+ * the records still held when the ring buffer memory is handed back to the kernel are copied by
+ * copy_pending(). The copies are kept in a pool of slots that are reused for the whole lifetime
+ * of the buffer, so there is no allocation in steady state.
+ */
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(std::chrono::nanoseconds horizon, std::size_t capacity)
+    : horizon_(horizon.count()), capacity_(capacity), slots_(capacity)
+    {
+        heap_.reserve(capacity_);
+        free_slots_.reserve(capacity_);
+        for (std::size_t i = 0; i < capacity_; i++)
+        {
+            free_slots_.push_back(capacity_ - 1 - i);
+        }
+    }
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+    bool enabled() const
+    {
+        return horizon_ > 0 && capacity_ > 0;
+    }
+
+    /* Put record with the given perf timestamp into the window and hand all records that left the
+     * window to release, in timestamp order. record must stay valid until the next call to
+     * copy_pending().
+     */
+    template <class F>
+    void push(std::uint64_t time, const perf_event_header* record, F&& release)
+    {
+        if (heap_.empty() && time >= released_time_ && time + horizon_ < newest_time_)
+        {
+            // Would leave the window right away
+            released_time_ = time;
+            release(record);
+            return;
+        }
+
+        if (heap_.size() == capacity_)
+        {
+            overflows_++;
+            pop(release);
+        }
+
+        if (time < released_time_)
+        {
+            // Too late even for the window, the writer has to clamp this one.
+            late_++;
+        }
+
+        heap_.push_back(Entry{ time, sequence_++, record, no_slot });
+        std::push_heap(heap_.begin(), heap_.end(), later);
+
+        newest_time_ = std::max(newest_time_, time);
+
+        while (!heap_.empty() && heap_.front().time + horizon_ < newest_time_)
+        {
+            pop(release);
+        }
+    }
+
+    // Copies the records that still point into the ring buffer, before it is handed back
+    void copy_pending()
+    {
+        for (auto& entry : heap_)
+        {
+            if (entry.slot != no_slot)
+            {
+                continue;
+            }
+            entry.slot = free_slots_.back();
+            free_slots_.pop_back();
+            auto& slot = slots_[entry.slot];
+            slot.resize(entry.record->size);
+            std::memcpy(slot.data(), entry.record, entry.record->size);
+            entry.record = reinterpret_cast<const perf_event_header*>(slot.data());
+        }
+    }
+
+    template <class F>
+    void flush(F&& release)
+    {
+        while (!heap_.empty())
+        {
+            pop(release);
+        }
+    }
+
+    std::size_t overflows() const
+    {
+        return overflows_;
+    }
+
+    std::size_t late() const
+    {
+        return late_;
+    }
+
+private:
+    static constexpr std::size_t no_slot = static_cast<std::size_t>(-1);
+
+    struct Entry
+    {
+        std::uint64_t time;
+        // Keeps records with equal timestamps in the order they were read
+        std::uint64_t sequence;
+        const perf_event_header* record;
+        // no_slot while the record is still in the ring buffer
+        std::size_t slot;
+    };
+
+    static bool later(const Entry& lhs, const Entry& rhs)
+    {
+        if (lhs.time != rhs.time)
+        {
+            return lhs.time > rhs.time;
+        }
+        return lhs.sequence > rhs.sequence;
+    }
+
+    template <class F>
+    void pop(F& release)
+    {
+        std::pop_heap(heap_.begin(), heap_.end(), later);
+        auto entry = heap_.back();
+        heap_.pop_back();
+
+        // A late record must not move the release mark back
+        released_time_ = std::max(released_time_, entry.time);
+        release(entry.record);
+        if (entry.slot != no_slot)
+        {
+            free_slots_.push_back(entry.slot);
+        }
+    }
+
+    const std::uint64_t horizon_;
+    const std::size_t capacity_;
+
+    std::vector<Entry> heap_;
+    // std::vector<std::byte> storage is suitably aligned for any perf record
+    std::vector<std::vector<std::byte>> slots_;
+    std::vector<std::size_t> free_slots_;
+
+    std::uint64_t sequence_ = 0;
+    std::uint64_t newest_time_ = 0;
+    std::uint64_t released_time_ = 0;
+
+    std::size_t overflows_ = 0;
+    std::size_t late_ = 0;
+};
+} // namespace perf
+} // namespace lo2s
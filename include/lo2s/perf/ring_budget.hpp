@@ -0,0 +1,91 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+namespace lo2s
+{
+namespace perf
+{
+
+/* The kinds of perf ring buffers. Per CPU, all tracepoints, i.e. those of -t and those of
+ * --wakeup-latency, share one TRACEPOINT ring buffer (see tracepoint::Reader::add_event), and
+ * with PERF_RECORD_SWITCH, the context switches are records in the SAMPLE ring buffer. The
+ * counter ring buffer stays separate from the sampling one: the layout of their sample records
+ * differs and could only be told apart by a PERF_SAMPLE_IDENTIFIER in front of every sample.
+ */
+enum class RingKind
+{
+    SAMPLE,
+    COUNTER,
+    TRACEPOINT,
+    SWITCH,
+    TIME,
+    OFF_CPU,
+    SIZE
+};
+
+/* Plans the sizes of all perf ring buffers, so that they fit into the memory the kernel allows
+ * us to lock: kernel.perf_event_mlock_kb per online CPU, plus RLIMIT_MEMLOCK. Root (or
+ * kernel.perf_event_paranoid = -1) is not limited.
+ *
+ * Each kind of reader has a preferred size, e.g. sampling with call stacks creates much more data
+ * than counters. If the readers that will be created at the start of the measurement do not fit
+ * with their preferred sizes, all sizes are scaled down by the same factor. In process monitoring
+ * mode, one thread per CPU is assumed. Readers that are created on top of the plan get what is
+ * left, memory of finished readers is handed out again.
+ *
+ * With an explicit -m, every ring buffer has that size.
+ */
+class RingBudget
+{
+public:
+    static RingBudget& instance()
+    {
+        static RingBudget budget;
+        return budget;
+    }
+
+    // Returns the number of data pages (a power of two) for a new ring buffer of the given kind
+    std::size_t reserve(RingKind kind);
+
+    // Hand back the data pages of a ring buffer that has been unmapped
+    void release(std::size_t pages);
+
+    // Account for a ring buffer that is mapped again with another size. Returns false, without
+    // changing anything, if growing it would exceed the budget.
+    bool resize(std::size_t old_pages, std::size_t new_pages);
+
+private:
+    RingBudget();
+
+    std::mutex mutex_;
+    // Lockable pages, including the header page of each ring buffer. 0 means unlimited.
+    std::size_t limit_ = 0;
+    std::size_t used_ = 0;
+    std::array<std::size_t, static_cast<std::size_t>(RingKind::SIZE)> planned_;
+};
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,100 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+extern "C"
+{
+#include <sys/types.h>
+
+#include <asm/perf_regs.h>
+#include <elfutils/libdwfl.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace sample
+{
+
+/* Unwinds the user space call stack of a sample from the registers and the copy of the stack that
+ * perf took at sampling time (PERF_SAMPLE_REGS_USER and PERF_SAMPLE_STACK_USER), using the CFI
+ * (.eh_frame or .debug_frame) of the binaries mapped into the process. Unlike the call chains of
+ * perf, this does not need frame pointers.
+ *
+ * The modules of each process are read from /proc/<pid>/maps on first use and cached until they
+ * are invalidated by a new mapping. Not thread-safe, every sample writer has its own unwinder.
+ */
+class DwarfUnwinder
+{
+public:
+    // The registers needed to apply the x86_64 CFI, in the order perf writes them into the sample
+    static constexpr uint64_t register_mask =
+        (1ULL << PERF_REG_X86_AX) | (1ULL << PERF_REG_X86_BX) | (1ULL << PERF_REG_X86_CX) |
+        (1ULL << PERF_REG_X86_DX) | (1ULL << PERF_REG_X86_SI) | (1ULL << PERF_REG_X86_DI) |
+        (1ULL << PERF_REG_X86_BP) | (1ULL << PERF_REG_X86_SP) | (1ULL << PERF_REG_X86_IP) |
+        (1ULL << PERF_REG_X86_R8) | (1ULL << PERF_REG_X86_R9) | (1ULL << PERF_REG_X86_R10) |
+        (1ULL << PERF_REG_X86_R11) | (1ULL << PERF_REG_X86_R12) | (1ULL << PERF_REG_X86_R13) |
+        (1ULL << PERF_REG_X86_R14) | (1ULL << PERF_REG_X86_R15);
+
+    static constexpr std::size_t max_frames = 256;
+
+    DwarfUnwinder() = default;
+    DwarfUnwinder(const DwarfUnwinder&) = delete;
+    DwarfUnwinder& operator=(const DwarfUnwinder&) = delete;
+    ~DwarfUnwinder();
+
+    // Rereads the modules of pid on the next unwind, e.g. after a new executable mapping
+    void invalidate(pid_t pid);
+
+    // Replaces frames with the instruction pointer and the return addresses of the call stack,
+    // innermost first. regs are the registers of register_mask in perf order. Yields at least the
+    // instruction pointer, even if the stack can not be unwound.
+    void unwind(pid_t pid, pid_t tid, const uint64_t* regs, const char* stack,
+                std::size_t stack_size, std::vector<uint64_t>& frames);
+
+private:
+    Dwfl* dwfl(pid_t pid);
+
+    static pid_t next_thread(Dwfl* dwfl, void* arg, void** thread_arg);
+    static bool memory_read(Dwfl* dwfl, Dwarf_Addr addr, Dwarf_Word* result, void* arg);
+    static bool set_initial_registers(Dwfl_Thread* thread, void* arg);
+    static int frame(Dwfl_Frame* state, void* arg);
+
+    // nullptr if the modules of the process could not be read, e.g. because it already exited
+    std::unordered_map<pid_t, Dwfl*> dwfls_;
+
+    // The sample that is currently unwound, for the libdwfl callbacks
+    pid_t tid_ = 0;
+    const uint64_t* regs_ = nullptr;
+    const char* stack_ = nullptr;
+    std::size_t stack_size_ = 0;
+    std::vector<uint64_t>* frames_ = nullptr;
+};
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
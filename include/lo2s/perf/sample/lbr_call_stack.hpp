@@ -0,0 +1,55 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace sample
+{
+
+/* Assembles the call stack of a sample with an LBR call stack (PERF_SAMPLE_BRANCH_CALL_STACK) in
+ * frames, innermost first: the instruction pointer of the sample, followed by the call sites of
+ * the calls that were active, which are the from addresses of the LBR entries.
+ */
+inline void lbr_call_stack(uint64_t ip, const struct perf_branch_entry* entries, uint64_t nr,
+                           std::vector<uint64_t>& frames)
+{
+    frames.resize(nr + 1);
+    frames[0] = ip;
+    for (uint64_t i = 0; i < nr; i++)
+    {
+        frames[i + 1] = entries[i].from;
+    }
+}
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+extern "C"
+{
+#include <sys/types.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace sample
+{
+
+// Where a sampled memory access was served from, decoded from PERF_SAMPLE_DATA_SRC. The values
+// are written into the trace, so only append to this list.
+enum class MemoryLevel : std::uint64_t
+{
+    UNKNOWN,
+    L1,
+    // Line fill buffer, i.e. a pending miss of the L1
+    LFB,
+    L2,
+    L3,
+    LOCAL_RAM,
+    // Cache of another socket
+    REMOTE_CACHE,
+    // Memory of another NUMA node
+    REMOTE_RAM,
+    // I/O or uncached memory
+    OTHER
+};
+
+MemoryLevel memory_level(std::uint64_t data_src);
+
+// Kind of the mapping that contains a data address. Only append, as with MemoryLevel.
+enum class DataRegion : std::uint64_t
+{
+    UNKNOWN,
+    HEAP,
+    // Stack of the main thread, the stacks of other threads are ANONYMOUS
+    STACK,
+    // Mapped from a file, i.e. the data of binaries and libraries or mapped files
+    FILE,
+    ANONYMOUS
+};
+
+/* Classifies data addresses by the mappings in /proc/<pid>/maps.
+ *
+ * The mappings are read on the first lookup for a process and read again when an address is not
+ * in any known mapping, but at most once per second per process to bound the overhead for
+ * addresses that are really unmapped. Not thread-safe.
+ */
+class DataRegions
+{
+public:
+    DataRegion classify(pid_t pid, std::uint64_t addr);
+
+private:
+    struct Mapping
+    {
+        std::uint64_t end;
+        DataRegion region;
+    };
+
+    struct Process
+    {
+        // By start address
+        std::map<std::uint64_t, Mapping> mappings;
+        std::chrono::steady_clock::time_point last_read;
+    };
+
+    static void read_maps(pid_t pid, Process& process);
+
+    std::unordered_map<pid_t, Process> processes_;
+};
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
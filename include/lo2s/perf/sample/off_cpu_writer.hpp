@@ -0,0 +1,123 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/event_reader.hpp>
+#include <lo2s/perf/time/converter.hpp>
+#include <lo2s/trace/trace.hpp>
+
+#include <otf2xx/chrono/time_point.hpp>
+#include <otf2xx/definition/calling_context.hpp>
+#include <otf2xx/writer/local.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C"
+{
+#include <sys/types.h>
+}
+
+namespace lo2s
+{
+namespace monitor
+{
+class MainMonitor;
+}
+
+namespace perf
+{
+namespace sample
+{
+
+/* With --off-cpu, records why a thread is not running.
+ *
+ * Every time the thread is switched out, the context switch software event takes the call chain
+ * of the thread, i.e. the kernel and user stack it blocked in. The time until the thread is
+ * switched in again is written as a calling context enter/leave of that stack, on a location of
+ * its own next to the sample location of the thread.
+ */
+class OffCpuWriter : public EventReader<OffCpuWriter>
+{
+public:
+    struct RecordSampleType
+    {
+        // BAD things happen if you try this
+        RecordSampleType() = delete;
+        RecordSampleType(const RecordSampleType&) = delete;
+        RecordSampleType& operator=(const RecordSampleType&) = delete;
+        RecordSampleType(RecordSampleType&&) = delete;
+        RecordSampleType& operator=(RecordSampleType&&) = delete;
+
+        struct perf_event_header header;
+        uint64_t ip;
+        uint32_t pid, tid;
+        uint64_t time;
+        uint32_t cpu, res;
+        uint64_t nr;
+        uint64_t ips[1]; // ISO C++ forbits zero-size array
+    };
+
+    OffCpuWriter(pid_t pid, pid_t tid, monitor::MainMonitor& monitor, trace::Trace& trace,
+                 bool enable_on_exec);
+    ~OffCpuWriter();
+
+    OffCpuWriter(const OffCpuWriter&) = delete;
+    OffCpuWriter& operator=(const OffCpuWriter&) = delete;
+
+    using EventReader<OffCpuWriter>::handle;
+    bool handle(const RecordSampleType* sample);
+    bool handle(const RecordSwitchType* context_switch);
+
+    // Closes the interval of a thread that is still switched out
+    void end();
+    void close();
+
+private:
+    // depth is the number of calling contexts from the thread down to the returned one
+    otf2::definition::calling_context::reference_type cctx_ref(const RecordSampleType* sample,
+                                                               std::size_t& depth);
+    void leave(otf2::chrono::time_point tp);
+    otf2::chrono::time_point adjust_timepoints(otf2::chrono::time_point tp);
+
+    pid_t pid_;
+    pid_t tid_;
+    int fd_ = -1;
+
+    monitor::MainMonitor& monitor_;
+    trace::Trace& trace_;
+    otf2::writer::local& otf2_writer_;
+
+    const time::Converter time_converter_;
+
+    trace::ThreadCctxRefMap local_cctx_refs_;
+    std::size_t next_cctx_ref_ = 0;
+
+    // The stack the thread blocked in while it is switched out
+    otf2::definition::calling_context::reference_type current_cctx_ =
+        otf2::definition::calling_context::reference_type::undefined();
+
+    otf2::chrono::time_point last_time_point_ = otf2::chrono::genesis();
+};
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
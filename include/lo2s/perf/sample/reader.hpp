@@ -21,8 +21,13 @@
 
 #pragma once
 
+#include <lo2s/perf/counter/counter_buffer.hpp>
+#include <lo2s/perf/counter/reader.hpp>
 #include <lo2s/perf/event_provider.hpp>
 #include <lo2s/perf/event_reader.hpp>
+#ifdef HAVE_LIBDW
+#include <lo2s/perf/sample/dwarf_unwinder.hpp>
+#endif
 #include <lo2s/perf/util.hpp>
 
 #include <lo2s/config.hpp>
@@ -30,7 +35,9 @@
 #include <lo2s/log.hpp>
 #include <lo2s/util.hpp>
 
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 #include <cstdlib>
 #include <cstring>
@@ -70,21 +77,126 @@ public:
         uint64_t ip;
         uint32_t pid, tid;
         uint64_t time;
-        uint32_t cpu, res;
-        /* only relevant for has_cct_ / PERF_SAMPLE_CALLCHAIN */
+        /* Followed by the data address (PERF_SAMPLE_ADDR, only with --memory-sampling), the cpu
+         * and the period (PERF_SAMPLE_PERIOD, only with --frequency or --adaptive-period), see
+         * addr(), cpu() and period(). Then come the values of the sample group (PERF_SAMPLE_READ,
+         * only with --sample-group-event) and either the call chain (PERF_SAMPLE_CALLCHAIN, with
+         * -g) or the user registers and stack (PERF_SAMPLE_REGS_USER and PERF_SAMPLE_STACK_USER,
+         * with --call-graph-mode dwarf) or the LBR call stack (PERF_SAMPLE_BRANCH_STACK, with
+         * --call-graph-mode lbr), see group_values(), callchain(), user_regs(), user_stack() and
+         * branch_stack(). The latency and data source of the access (PERF_SAMPLE_WEIGHT and
+         * PERF_SAMPLE_DATA_SRC, with --memory-sampling) come last, see memory_access(). */
+        uint64_t data[1]; // ISO C++ forbits zero-size array
+    };
+
+    struct Callchain
+    {
         uint64_t nr;
         uint64_t ips[1]; // ISO C++ forbits zero-size array
     };
 
+    struct UserRegs
+    {
+        // PERF_SAMPLE_REGS_ABI_NONE if the sample has no user state, e.g. in a kernel thread
+        uint64_t abi;
+        uint64_t regs[1]; // ISO C++ forbits zero-size array
+    };
+
+    struct UserStack
+    {
+        uint64_t size;
+        // Followed by the size of the part of the stack that was in use, if size is not 0
+        char data[1]; // ISO C++ forbits zero-size array
+    };
+
+    struct BranchStack
+    {
+        uint64_t nr;
+        struct perf_branch_entry entries[1]; // ISO C++ forbits zero-size array
+    };
+
+    struct MemoryAccess
+    {
+        // Latency of the access in cycles
+        uint64_t weight;
+        // union perf_mem_data_src
+        uint64_t data_src;
+    };
+
+    // Whether samples carry their period, see period()
+    bool has_period() const
+    {
+        return has_period_;
+    }
+
+    // Only with --memory-sampling
+    uint64_t addr(const RecordSampleType* sample) const
+    {
+        return sample->data[0];
+    }
+
+    uint32_t cpu(const RecordSampleType* sample) const
+    {
+        // struct { u32 cpu, res; }
+        return reinterpret_cast<const uint32_t*>(sample->data + cpu_offset_)[0];
+    }
+
+    uint64_t period(const RecordSampleType* sample) const
+    {
+        return sample->data[cpu_offset_ + 1];
+    }
+
+    const counter::GroupReadFormat* group_values(const RecordSampleType* sample) const
+    {
+        return reinterpret_cast<const counter::GroupReadFormat*>(sample->data + group_offset_);
+    }
+
+    const Callchain* callchain(const RecordSampleType* sample) const
+    {
+        return reinterpret_cast<const Callchain*>(sample->data + callchain_offset_);
+    }
+
+    const UserRegs* user_regs(const RecordSampleType* sample) const
+    {
+        return reinterpret_cast<const UserRegs*>(sample->data + callchain_offset_);
+    }
+
+    const BranchStack* branch_stack(const RecordSampleType* sample) const
+    {
+        return reinterpret_cast<const BranchStack*>(sample->data + callchain_offset_);
+    }
+
+    const MemoryAccess* memory_access(const RecordSampleType* sample) const
+    {
+        // PERF_SAMPLE_WEIGHT and PERF_SAMPLE_DATA_SRC are the last fields of a sample
+        return reinterpret_cast<const MemoryAccess*>(reinterpret_cast<const char*>(sample) +
+                                                     sample->header.size - sizeof(MemoryAccess));
+    }
+
+    // Whether the call stacks come from the LBR, which may have fallen back to call chains
+    bool lbr_call_stacks() const
+    {
+        return lbr_call_stacks_;
+    }
+
+    const UserStack* user_stack(const RecordSampleType* sample) const
+    {
+        const auto* regs = user_regs(sample);
+        return reinterpret_cast<const UserStack*>(
+            regs->regs + (regs->abi == PERF_SAMPLE_REGS_ABI_NONE ? 0 : user_regs_count_));
+    }
+
 protected:
     using EventReader<T>::init_mmap;
 
-    Reader(pid_t tid, int cpu, bool enable_on_exec) : has_cct_(config().enable_cct)
+    Reader(pid_t tid, int cpu, bool enable_on_exec)
+    : EventReader<T>(RingKind::SAMPLE), has_cct_(config().enable_cct)
     {
         Log::debug() << "initializing event_reader for tid: " << tid
                      << ", enable_on_exec: " << enable_on_exec;
 
         struct perf_event_attr perf_attr = common_perf_event_attrs();
+        set_wakeup_watermark(perf_attr, this->mmap_pages_);
 #ifdef USE_PERF_CLOCKID
         if (config().use_pebs)
         {
@@ -93,7 +205,15 @@ protected:
 #endif
 
         perf_attr.exclude_kernel = config().exclude_kernel;
-        perf_attr.sample_period = config().sampling_period;
+        if (config().sampling_use_frequency)
+        {
+            perf_attr.freq = 1;
+            perf_attr.sample_freq = config().sampling_frequency;
+        }
+        else
+        {
+            perf_attr.sample_period = config().sampling_period;
+        }
 
         if (config().sampling)
         {
@@ -102,8 +222,9 @@ protected:
                                           // checked for event
                                           // availability, should not throw
 
-            Log::debug() << "using sampling event \'" << config().sampling_event
-                         << "\', period: " << config().sampling_period;
+            Log::debug() << "using sampling event \'" << config().sampling_event << "\', "
+                         << (perf_attr.freq ? "frequency: " : "period: ")
+                         << (perf_attr.freq ? perf_attr.sample_freq : perf_attr.sample_period);
 
             perf_attr.type = sampling_event.type;
             perf_attr.config = sampling_event.config;
@@ -136,33 +257,93 @@ protected:
         // TODO see if we can remove remove tid
         perf_attr.sample_type =
             PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU;
-        if (has_cct_)
+        if (config().memory_sampling)
+        {
+            perf_attr.sample_type |= PERF_SAMPLE_ADDR | PERF_SAMPLE_WEIGHT | PERF_SAMPLE_DATA_SRC;
+            cpu_offset_ = 1;
+        }
+        group_offset_ = cpu_offset_ + 1;
+        // The period is needed to weight the samples whenever it is not fixed
+        if (config().sampling && (config().sampling_use_frequency || config().adaptive_period))
+        {
+            perf_attr.sample_type |= PERF_SAMPLE_PERIOD;
+            has_period_ = true;
+            group_offset_++;
+        }
+        if (has_cct_ && config().call_graph_mode == CallGraphMode::DWARF)
+        {
+#ifdef HAVE_LIBDW
+            // The stack is unwound in user space, the kernel only takes a snapshot
+            perf_attr.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
+            perf_attr.sample_regs_user = DwarfUnwinder::register_mask;
+            perf_attr.sample_stack_user = config().stack_dump_size;
+            user_regs_count_ = __builtin_popcountll(DwarfUnwinder::register_mask);
+#endif
+        }
+        else if (has_cct_ && config().call_graph_mode == CallGraphMode::LBR)
+        {
+            perf_attr.sample_type |= PERF_SAMPLE_BRANCH_STACK;
+            perf_attr.branch_sample_type = PERF_SAMPLE_BRANCH_USER | PERF_SAMPLE_BRANCH_CALL_STACK;
+        }
+        else if (has_cct_)
         {
             perf_attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
         }
-
-        perf_attr.precise_ip = 3;
-        /* precise_ip is an unsigned integer therefore we have to check if we get an underflow
-         * and the value of it is greater than the initial value */
-        do
+        callchain_offset_ = group_offset_;
+        if (config().sampling && !config().sampling_group_events.empty())
         {
-            fd_ = perf_event_open(&perf_attr, tid, cpu, -1, 0);
+            // Every sample carries the values of all events in the group of the sampling event
+            perf_attr.sample_type |= PERF_SAMPLE_READ;
+            perf_attr.read_format =
+                PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING | PERF_FORMAT_GROUP;
+            callchain_offset_ += counter::GroupReadFormat::total_size(
+                                     config().sampling_group_events.size() + 1) /
+                                 sizeof(uint64_t);
+        }
 
-            if (errno == EACCES && !perf_attr.exclude_kernel && perf_event_paranoid() > 1)
+        while (true)
+        {
+            perf_attr.precise_ip = 3;
+            /* precise_ip is an unsigned integer therefore we have to check if we get an underflow
+             * and the value of it is greater than the initial value */
+            do
             {
-                perf_attr.exclude_kernel = 1;
+                fd_ = perf_event_open(&perf_attr, tid, cpu, -1, 0);
 
-                perf_warn_paranoid();
+                if (errno == EACCES && !perf_attr.exclude_kernel && perf_event_paranoid() > 1)
+                {
+                    perf_attr.exclude_kernel = 1;
 
-                continue;
-            }
+                    perf_warn_paranoid();
+
+                    continue;
+                }
+
+                /* reduce exactness of IP can help if the kernel does not support really exact
+                 * events */
+                if (perf_attr.precise_ip == 0)
+                    break;
+                else
+                    perf_attr.precise_ip--;
+            } while (fd_ <= 0);
 
-            /* reduce exactness of IP can help if the kernel does not support really exact events */
-            if (perf_attr.precise_ip == 0)
+            if (fd_ >= 0 || !(perf_attr.sample_type & PERF_SAMPLE_BRANCH_STACK))
+            {
                 break;
-            else
-                perf_attr.precise_ip--;
-        } while (fd_ <= 0);
+            }
+
+            // Not every CPU has LBRs and the kernel only supports LBR call stacks for tasks, not
+            // for whole CPUs
+            static std::once_flag lbr_fallback_warning;
+            std::call_once(lbr_fallback_warning, []() {
+                Log::warn() << "LBR call stacks are not available, falling back to frame pointer "
+                               "call chains";
+            });
+            perf_attr.sample_type &= ~PERF_SAMPLE_BRANCH_STACK;
+            perf_attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+            perf_attr.branch_sample_type = 0;
+        }
+        lbr_call_stacks_ = perf_attr.sample_type & PERF_SAMPLE_BRANCH_STACK;
 
         if (fd_ < 0)
         {
@@ -175,6 +356,11 @@ protected:
                 Log::error() << "maybe the specified clock is unavailable?";
             }
 #endif
+            if (perf_attr.freq)
+            {
+                Log::error() << "maybe the sampling frequency exceeds "
+                                "/proc/sys/kernel/perf_event_max_sample_rate?";
+            }
             throw_errno();
         }
         Log::debug() << "Using precise_ip level: " << perf_attr.precise_ip;
@@ -189,6 +375,16 @@ protected:
                 throw_errno();
             }
 
+            if (perf_attr.sample_type & PERF_SAMPLE_READ)
+            {
+                for (const auto& event : config().sampling_group_events)
+                {
+                    // The group members follow the leader, so they are enabled along with it
+                    group_fds_.push_back(counter::open_counter(
+                        tid, cpu, EventProvider::get_event_by_name(event), fd_));
+                }
+            }
+
             init_mmap(fd_);
             Log::debug() << "mmap initialized";
 
@@ -233,6 +429,12 @@ protected:
 public:
     void close()
     {
+        for (int fd : group_fds_)
+        {
+            ::close(fd);
+        }
+        group_fds_.clear();
+
         if (fd_ != -1)
         {
             ::close(fd_);
@@ -245,6 +447,15 @@ protected:
 
 private:
     int fd_ = -1;
+    std::vector<int> group_fds_;
+    bool has_period_ = false;
+    // Positions of the cpu, the group values and the call chain or user registers in
+    // RecordSampleType::data, behind the optional fields
+    std::size_t cpu_offset_ = 0;
+    std::size_t group_offset_ = 0;
+    std::size_t callchain_offset_ = 0;
+    std::size_t user_regs_count_ = 0;
+    bool lbr_call_stacks_ = false;
 };
 } // namespace sample
 } // namespace perf
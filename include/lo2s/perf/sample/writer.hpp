@@ -23,6 +23,9 @@
 
 #include <lo2s/address.hpp>
 #include <lo2s/mmap.hpp>
+#include <lo2s/perf/reorder_buffer.hpp>
+#include <lo2s/perf/sample/lbr_call_stack.hpp>
+#include <lo2s/perf/sample/memory_access.hpp>
 #include <lo2s/perf/sample/reader.hpp>
 #include <lo2s/perf/time/converter.hpp>
 #include <lo2s/trace/trace.hpp>
@@ -31,7 +34,11 @@
 #include <otf2xx/definition/calling_context.hpp>
 #include <otf2xx/definition/location.hpp>
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <vector>
 
 extern "C"
 {
@@ -79,17 +86,48 @@ public:
     }
     void end();
 
+    void records_handled();
+    void readout_done(double fill, std::chrono::nanoseconds duration);
+
 private:
     otf2::definition::calling_context::reference_type
     cctx_ref(const Reader::RecordSampleType* sample);
+    // ips is a call stack, innermost first
+    otf2::definition::calling_context::reference_type cctx_ref(const uint64_t* ips,
+                                                               std::size_t nr);
+    // Whether cctx_ref() assembles the call stacks in frames_, instead of using the call chain
+    bool stack_in_frames() const
+    {
+#ifdef HAVE_LIBDW
+        if (unwinder_)
+        {
+            return true;
+        }
+#endif
+        return lbr_call_stacks();
+    }
     trace::IpRefMap::iterator find_ip_child(Address addr, trace::IpRefMap& children);
 
+    void release(const perf_event_header* record);
+    void write(const perf_event_header* record);
+#ifdef HAVE_LIBDW
+    void defer(const perf_event_header* record);
+    void write_deferred();
+#endif
+    void write_sample(const Reader::RecordSampleType* sample);
+#ifdef USE_PERF_RECORD_SWITCH
+    void write_switch(const Reader::RecordSwitchCpuWideType* context_switch);
+    void write_switch(const Reader::RecordSwitchType* context_switch);
+#endif
+
     void update_current_thread(pid_t pid, pid_t tid, otf2::chrono::time_point tp);
     void leave_current_thread(pid_t tid, otf2::chrono::time_point tp);
     void update_calling_context(pid_t pid, pid_t tid, otf2::chrono::time_point tp, bool switch_out);
 
     otf2::chrono::time_point adjust_timepoints(otf2::chrono::time_point tp);
 
+    void set_period(std::uint64_t period);
+
     pid_t pid_;
     pid_t tid_;
     int cpuid_;
@@ -112,6 +150,40 @@ private:
 
     const time::Converter time_converter_;
 
+    ReorderBuffer reorder_buffer_;
+
+    // With --adaptive-period, the sampling period is raised while the reader is overloaded and
+    // lowered back to the requested period once the load drops
+    bool adapt_period_;
+    std::uint64_t period_;
+    std::uint64_t lost_at_last_readout_ = 0;
+    std::uint64_t throttled_at_last_readout_ = 0;
+    std::size_t relaxed_readouts_ = 0;
+
+    // With --sample-group-event, the values of the group events between two samples
+    std::optional<counter::CounterBuffer> group_buffer_;
+    std::vector<double> previous_group_values_;
+    std::optional<otf2::event::metric> group_event_;
+
+#ifdef HAVE_LIBDW
+    // With --call-graph-mode dwarf, records are copied out of the ring buffer and only written
+    // after the readout, so that unwinding the stacks does not hold up the ring buffer. Switch
+    // records are deferred as well to keep the order. The copies are reused between readouts.
+    std::optional<DwarfUnwinder> unwinder_;
+    std::vector<std::vector<std::byte>> deferred_;
+    std::size_t deferred_count_ = 0;
+#endif
+    // The unwound or LBR call stack of the sample that is currently written
+    std::vector<uint64_t> frames_;
+
+    // With --memory-sampling, the data address, latency and source of each sampled access
+    std::optional<otf2::event::metric> memory_event_;
+    DataRegions data_regions_;
+
+    // The period of each sample, written with the sample whenever it differs from the previous one
+    std::optional<otf2::event::metric> sample_period_event_;
+    std::uint64_t last_sample_period_ = 0;
+
     bool first_event_ = true;
     otf2::chrono::time_point first_time_point_;
     otf2::chrono::time_point last_time_point_;
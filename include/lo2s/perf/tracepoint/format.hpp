@@ -22,6 +22,7 @@
 #pragma once
 
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <cstddef>
@@ -87,6 +88,31 @@ private:
     std::size_t size_ = 0;
 };
 
+class InvalidFilter : public std::runtime_error
+{
+public:
+    InvalidFilter(const std::string& what) : std::runtime_error(what)
+    {
+    }
+};
+
+// A tracepoint as given to -t: "group:name" or "group/name", optionally followed by a filter
+// expression that is evaluated by the kernel, e.g. "sched:sched_switch/prev_pid==1234/"
+struct EventSpec
+{
+    EventSpec(const std::string& spec);
+
+    std::string name;
+    std::string filter;
+};
+
+// Throws InvalidFilter if filter does not compare any field of the tracepoint event, or a field
+// that is neither in fields nor in common_fields. Anything else about the syntax is checked by the
+// kernel.
+void validate_filter(const std::string& event, const std::string& filter,
+                     const std::vector<EventField>& fields,
+                     const std::vector<EventField>& common_fields);
+
 class EventFormat
 {
 public:
@@ -130,6 +156,9 @@ public:
         throw std::out_of_range("field not found");
     }
 
+    // See tracepoint::validate_filter()
+    void validate_filter(const std::string& filter) const;
+
     static std::vector<std::string> get_tracepoint_event_names();
 
 private:
@@ -33,6 +33,8 @@
 #include <filesystem>
 
 #include <ios>
+#include <string>
+#include <vector>
 
 #include <cstddef>
 
@@ -42,6 +44,7 @@ extern "C"
 #include <linux/perf_event.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/types.h>
 }
 
 namespace lo2s
@@ -106,28 +109,24 @@ public:
     struct RecordSampleType
     {
         struct perf_event_header header;
+        uint64_t id;
         uint64_t time;
         // uint32_t size;
         // char data[size];
         RecordDynamicFormat raw_data;
     };
 
-    Reader(int cpu, int event_id) : cpu_(cpu)
+    Reader(int cpu, int event_id, const std::string& filter = std::string(),
+           RingKind kind = RingKind::TRACEPOINT)
+    : Reader(-1, cpu, event_id, filter, kind)
     {
-        struct perf_event_attr attr = common_perf_event_attrs();
-        attr.type = PERF_TYPE_TRACEPOINT;
-        attr.config = event_id;
-        attr.sample_period = 1;
-        attr.sample_type = PERF_SAMPLE_RAW | PERF_SAMPLE_TIME;
+    }
 
-        fd_ = perf_event_open(&attr, -1, cpu_, -1, 0);
-        if (fd_ < 0)
-        {
-            Log::error() << "perf_event_open for raw tracepoint failed.";
-            throw_errno();
-        }
-        Log::debug() << "Opened perf_sample_tracepoint_reader for cpu " << cpu_ << " with id "
-                     << event_id;
+    // Records the tracepoint only for the thread tid (on any CPU, if cpu is -1)
+    Reader(pid_t tid, int cpu, int event_id, const std::string& filter, RingKind kind)
+    : EventReader<T>(kind), tid_(tid), cpu_(cpu)
+    {
+        fd_ = open_event(event_id, filter);
 
         try
         {
@@ -141,12 +140,8 @@ public:
             init_mmap(fd_);
             Log::debug() << "perf_tracepoint_reader mmap initialized";
 
-            auto ret = ioctl(fd_, PERF_EVENT_IOC_ENABLE);
-            Log::debug() << "perf_tracepoint_reader ioctl(fd, PERF_EVENT_IOC_ENABLE) = " << ret;
-            if (ret == -1)
-            {
-                throw_errno();
-            }
+            id_ = sample_id(fd_);
+            enable(fd_);
         }
         catch (...)
         {
@@ -156,36 +151,153 @@ public:
     }
 
     Reader(Reader&& other)
-    : EventReader<T>(std::forward<perf::EventReader<T>>(other)), cpu_(other.cpu_)
+    : EventReader<T>(std::forward<perf::EventReader<T>>(other)), tid_(other.tid_),
+      cpu_(other.cpu_), id_(other.id_)
     {
         std::swap(fd_, other.fd_);
+        std::swap(output_fds_, other.output_fds_);
     }
 
     ~Reader()
     {
+        for (int fd : output_fds_)
+        {
+            close(fd);
+        }
         if (fd_ != -1)
         {
             close(fd_);
         }
     }
 
+    void redirect_outputs()
+    {
+        for (int fd : output_fds_)
+        {
+            if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, fd_) == -1)
+            {
+                Log::error() << "failed to redirect tracepoint into the shared ring buffer";
+                throw_errno();
+            }
+        }
+    }
+
     void stop()
     {
-        auto ret = ioctl(fd_, PERF_EVENT_IOC_DISABLE);
-        Log::debug() << "perf_tracepoint_reader ioctl(fd, PERF_EVENT_IOC_DISABLE) = " << ret;
-        if (ret == -1)
+        for (int fd : output_fds_)
         {
-            throw_errno();
+            disable(fd);
         }
+        disable(fd_);
+        thread_final_readout() = true;
         this->read();
+        thread_final_readout() = false;
+    }
+
+protected:
+    // The sample id of the event passed to the constructor
+    uint64_t id() const
+    {
+        return id_;
+    }
+
+    /* Records another tracepoint on this CPU into the same ring buffer, instead of mapping one
+     * buffer per tracepoint. Returns the sample id by which its records can be told apart from
+     * the others, see RecordSampleType::id.
+     */
+    uint64_t add_event(int event_id, const std::string& filter = std::string())
+    {
+        int fd = open_event(event_id, filter);
+        try
+        {
+            if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, fd_) == -1)
+            {
+                Log::error() << "failed to redirect tracepoint into the shared ring buffer";
+                throw_errno();
+            }
+            auto id = sample_id(fd);
+            enable(fd);
+            output_fds_.push_back(fd);
+            return id;
+        }
+        catch (...)
+        {
+            close(fd);
+            throw;
+        }
     }
 
 protected:
     using EventReader<T>::init_mmap;
 
 private:
+    int open_event(int event_id, const std::string& filter)
+    {
+        struct perf_event_attr attr = common_perf_event_attrs();
+        set_wakeup_watermark(attr, this->mmap_pages_);
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.config = event_id;
+        attr.sample_period = 1;
+        attr.sample_type = PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_TIME | PERF_SAMPLE_RAW;
+
+        int fd = perf_event_open(&attr, tid_, cpu_, -1, 0);
+        if (fd < 0)
+        {
+            Log::error() << "perf_event_open for raw tracepoint failed.";
+            throw_errno();
+        }
+        Log::debug() << "Opened perf_sample_tracepoint_reader for tid " << tid_ << ", cpu " << cpu_
+                     << " with id " << event_id;
+
+        // Records that do not match the filter are dropped by the kernel
+        if (!filter.empty() && ioctl(fd, PERF_EVENT_IOC_SET_FILTER, filter.c_str()) == -1)
+        {
+            Log::error() << "failed to set tracepoint filter '" << filter << "'";
+            auto errno_copy = errno;
+            close(fd);
+            errno = errno_copy;
+            throw_errno();
+        }
+        return fd;
+    }
+
+    static uint64_t sample_id(int fd)
+    {
+        uint64_t id;
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &id) == -1)
+        {
+            Log::error() << "failed to get the sample id of a tracepoint";
+            throw_errno();
+        }
+        return id;
+    }
+
+    static void enable(int fd)
+    {
+        auto ret = ioctl(fd, PERF_EVENT_IOC_ENABLE);
+        Log::debug() << "perf_tracepoint_reader ioctl(fd, PERF_EVENT_IOC_ENABLE) = " << ret;
+        if (ret == -1)
+        {
+            throw_errno();
+        }
+    }
+
+    static void disable(int fd)
+    {
+        auto ret = ioctl(fd, PERF_EVENT_IOC_DISABLE);
+        Log::debug() << "perf_tracepoint_reader ioctl(fd, PERF_EVENT_IOC_DISABLE) = " << ret;
+        if (ret == -1)
+        {
+            throw_errno();
+        }
+    }
+
+    pid_t tid_;
     int cpu_;
     int fd_ = -1;
+    uint64_t id_ = 0;
+    // Tracepoints redirected into the ring buffer of fd_
+    std::vector<int> output_fds_;
     const static std::filesystem::path base_path;
 };
 
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/tracepoint/format.hpp>
+#include <lo2s/perf/tracepoint/reader.hpp>
+
+#include <lo2s/perf/time/converter.hpp>
+
+#include <lo2s/trace/trace.hpp>
+
+#include <otf2xx/chrono/time_point.hpp>
+#include <otf2xx/writer/local.hpp>
+
+#include <cstdint>
+
+extern "C"
+{
+#include <sys/types.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+// Note, this cannot be protected for CRTP reasons...
+/* With --syscalls, records the system calls of one thread from the raw_syscalls:sys_enter and
+ * raw_syscalls:sys_exit tracepoints. Each enter is paired with the following exit and written as
+ * an enter/leave of the region of that syscall, on a location of its own next to the sample
+ * location of the thread. Syscalls shorter than --syscall-min-duration are dropped.
+ */
+class SyscallWriter : public Reader<SyscallWriter>
+{
+public:
+    SyscallWriter(pid_t pid, pid_t tid, trace::Trace& trace);
+
+    SyscallWriter(const SyscallWriter& other) = delete;
+
+public:
+    using Reader<SyscallWriter>::handle;
+
+    bool handle(const Reader::RecordSampleType* sample);
+
+    // Writes the syscall the thread is still in, e.g. exit_group, which never returns
+    void end();
+
+private:
+    void write(uint64_t exit_time);
+
+    otf2::writer::local& writer_;
+    trace::Trace& trace_;
+
+    const time::Converter time_converter_;
+
+    uint64_t exit_id_;
+
+    EventField enter_nr_field_;
+    EventField exit_nr_field_;
+
+    // The syscall the thread is in, if in_syscall_
+    bool in_syscall_ = false;
+    int64_t syscall_nr_ = -1;
+    uint64_t enter_time_ = 0;
+
+    const uint64_t min_duration_;
+    uint64_t dropped_ = 0;
+};
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+
+// Name of the system call with the given number on this architecture, e.g. "read" for 0 on
+// x86_64. Unknown numbers yield "syscall <nr>", as do all numbers on other architectures, which
+// is logged once. The tracefs syscalls events can not be used instead, their ids are event ids.
+std::string syscall_name(int64_t nr);
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,200 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+extern "C"
+{
+#include <sys/types.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+/* sched_wakeup fires on the CPU of the waker, which is often not the one the thread is switched in
+ * on, so the wakeups are shared between the writers of all CPUs. The writers read their ring
+ * buffers independently, a switch-in may therefore be seen before the wakeup that preceded it, or
+ * the other way round. To never pair a thread with a wakeup from before it last ran, the table
+ * also keeps the time of the last switch of each thread, wakeups older than that are stale.
+ *
+ * A wakeup that is only read after the switch-in of its thread is still paired with it, as long
+ * as that switch-in was the last one of the thread. Its latency can not be written to the trace
+ * anymore, the location of the CPU that switched the thread in is already past it.
+ *
+ * Threads that have not been seen for forget_after are removed from the table, so that it does not
+ * grow with every thread that ever ran. Wakeups older than that are dropped, as their thread may
+ * already have been forgotten.
+ */
+class WakeupTable
+{
+public:
+    // The table shared by the writers of all CPUs
+    static WakeupTable& instance()
+    {
+        static WakeupTable table;
+        return table;
+    }
+
+    // Returns the runqueue latency if the thread was already switched in, or -1
+    int64_t wakeup(pid_t tid, uint64_t time)
+    {
+        auto& shard = shard_of(tid);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        if (forget(shard, time))
+        {
+            return -1;
+        }
+
+        auto& thread = shard.threads[tid];
+        thread.last_seen = std::max(thread.last_seen, time);
+        if (time > thread.last_switch)
+        {
+            // Keep the first wakeup, the thread was runnable from then on
+            thread.wakeup = thread.wakeup == 0 ? time : std::min(thread.wakeup, time);
+            return -1;
+        }
+
+        if (thread.unpaired_switch_in != 0 && time > thread.switch_before_unpaired &&
+            time <= thread.unpaired_switch_in)
+        {
+            int64_t latency = thread.unpaired_switch_in - time;
+            thread.unpaired_switch_in = 0;
+            return latency;
+        }
+        return -1;
+    }
+
+    void switch_out(pid_t tid, uint64_t time)
+    {
+        update(tid, time, false);
+    }
+
+    // Returns the runqueue latency of a thread that is switched in at time, or -1 if there is no
+    // wakeup for it (yet)
+    int64_t switch_in(pid_t tid, uint64_t time)
+    {
+        return update(tid, time, true);
+    }
+
+    // In perf time, i.e. nanoseconds
+    static constexpr uint64_t forget_after = 10'000'000'000;
+
+    // Number of threads in the table
+    std::size_t size()
+    {
+        std::size_t size = 0;
+        for (auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            size += shard.threads.size();
+        }
+        return size;
+    }
+
+private:
+    struct Thread
+    {
+        uint64_t wakeup = 0;
+        uint64_t last_switch = 0;
+        // The last switch-in without a wakeup and the switch of the thread before it
+        uint64_t unpaired_switch_in = 0;
+        uint64_t switch_before_unpaired = 0;
+        uint64_t last_seen = 0;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<pid_t, Thread> threads;
+        uint64_t newest = 0;
+        uint64_t next_sweep = 0;
+    };
+
+    Shard& shard_of(pid_t tid)
+    {
+        return shards_[static_cast<std::size_t>(tid) % shards_.size()];
+    }
+
+    // Removes the threads of the shard that have not been seen for forget_after, at most once per
+    // forget_after. Returns whether time itself is too old to be looked up.
+    bool forget(Shard& shard, uint64_t time)
+    {
+        shard.newest = std::max(shard.newest, time);
+        if (shard.newest >= shard.next_sweep)
+        {
+            for (auto it = shard.threads.begin(); it != shard.threads.end();)
+            {
+                if (it->second.last_seen + forget_after < shard.newest)
+                {
+                    it = shard.threads.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            shard.next_sweep = shard.newest + forget_after;
+        }
+        return time + forget_after < shard.newest;
+    }
+
+    int64_t update(pid_t tid, uint64_t time, bool switch_in)
+    {
+        auto& shard = shard_of(tid);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        if (forget(shard, time))
+        {
+            return -1;
+        }
+
+        auto& thread = shard.threads[tid];
+        thread.last_seen = std::max(thread.last_seen, time);
+        int64_t latency = -1;
+        if (thread.wakeup != 0 && thread.wakeup <= time)
+        {
+            latency = time - thread.wakeup;
+            thread.wakeup = 0;
+        }
+        else if (switch_in)
+        {
+            thread.unpaired_switch_in = time;
+            thread.switch_before_unpaired = thread.last_switch;
+        }
+        thread.last_switch = std::max(thread.last_switch, time);
+        return switch_in ? latency : -1;
+    }
+
+    // Spread the threads over several locks, as every context switch of every CPU ends up here
+    std::array<Shard, 64> shards_;
+};
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,99 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <lo2s/perf/tracepoint/format.hpp>
+#include <lo2s/perf/tracepoint/reader.hpp>
+
+#include <lo2s/perf/time/converter.hpp>
+
+#include <lo2s/histogram.hpp>
+#include <lo2s/trace/trace.hpp>
+
+#include <otf2xx/event/metric.hpp>
+#include <otf2xx/writer/local.hpp>
+
+#include <cstdint>
+#include <functional>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+class Writer;
+
+/* With --wakeup-latency, pairs the sched_wakeup and sched_wakeup_new events of a thread with its
+ * next switch-in by sched_switch. The time in between, the runqueue latency, is written as a
+ * metric of the CPU that switches the thread in, together with the tid. There is no location per
+ * thread to write them to instead: in system-wide monitoring, threads only appear in the calling
+ * context trees, and the switch-ins of one thread are read on different CPUs. All latencies also go
+ * into a histogram that is shown in the summary, including those whose wakeup was only read after
+ * the switch-in had been written.
+ *
+ * The scheduler tracepoints are recorded in the ring buffer of the tracepoint::Writer of the CPU,
+ * which passes their records on.
+ */
+class WakeupWriter
+{
+public:
+    // The tracepoint that add_event is called with first
+    static constexpr const char* first_event = "sched:sched_switch";
+
+    // add_event records a tracepoint in the ring buffer of the Writer and returns its sample id
+    WakeupWriter(int cpu, trace::Trace& trace, const std::function<uint64_t(int)>& add_event);
+    ~WakeupWriter();
+
+    WakeupWriter(const WakeupWriter& other) = delete;
+    WakeupWriter& operator=(const WakeupWriter& other) = delete;
+
+    // Returns false if sample is none of the scheduler tracepoints
+    bool handle(const Reader<Writer>::RecordSampleType* sample);
+
+    otf2::definition::location location() const
+    {
+        return writer_.location();
+    }
+
+private:
+    otf2::writer::local& writer_;
+    otf2::event::metric metric_event_;
+
+    const time::Converter time_converter_;
+
+    uint64_t switch_id_;
+    uint64_t wakeup_id_;
+    uint64_t wakeup_new_id_;
+
+    EventField prev_pid_field_;
+    EventField next_pid_field_;
+    EventField wakeup_pid_field_;
+    EventField wakeup_new_pid_field_;
+
+    LatencyHistogram histogram_;
+    // Latencies that are only in the histogram, see WakeupTable
+    std::uint64_t late_latencies_ = 0;
+};
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
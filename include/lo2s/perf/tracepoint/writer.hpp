@@ -23,6 +23,7 @@
 
 #include <lo2s/perf/tracepoint/format.hpp>
 #include <lo2s/perf/tracepoint/reader.hpp>
+#include <lo2s/perf/tracepoint/wakeup_writer.hpp>
 
 #include <lo2s/perf/time/converter.hpp>
 
@@ -32,6 +33,9 @@
 #include <otf2xx/event/metric.hpp>
 #include <otf2xx/writer/local.hpp>
 
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace lo2s
@@ -41,11 +45,14 @@ namespace perf
 namespace tracepoint
 {
 // Note, this cannot be protected for CRTP reasons...
+// Records all requested tracepoints of one CPU through a single ring buffer, the records are
+// dispatched to the metric instance of their tracepoint by their sample id. With wakeup_latency,
+// the scheduler tracepoints of the WakeupWriter go through the same ring buffer.
 class Writer : public Reader<Writer>
 {
 public:
-    Writer(int cpu, const EventFormat& event, trace::Trace& trace,
-           const otf2::definition::metric_class& metric_class);
+    Writer(int cpu, trace::Trace& trace, const std::vector<std::string>& tracepoints,
+           bool wakeup_latency);
 
     Writer(const Writer& other) = delete;
 
@@ -57,13 +64,28 @@ public:
     bool handle(const Reader::RecordSampleType* sample);
 
 private:
-    EventFormat event_;
-    otf2::writer::local& writer_;
-    otf2::definition::metric_instance metric_instance_;
+    // Returns the sample id of the tracepoint, the first one is the tracepoint that the ring
+    // buffer was opened with
+    uint64_t record(int event_id, const std::string& filter);
 
-    const time::Converter time_converter_;
+    struct Event
+    {
+        Event(const EventFormat& format, const otf2::definition::metric_instance& metric_instance)
+        : format(format), metric_event(otf2::chrono::genesis(), metric_instance)
+        {
+        }
+
+        EventFormat format;
+        otf2::event::metric metric_event;
+    };
 
-    otf2::event::metric metric_event_;
+    // nullptr without requested tracepoints
+    otf2::writer::local* writer_ = nullptr;
+    std::unordered_map<uint64_t, Event> events_;
+    std::unique_ptr<WakeupWriter> wakeup_writer_;
+    bool first_recorded_ = false;
+
+    const time::Converter time_converter_;
 };
 } // namespace tracepoint
 } // namespace perf
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cerrno>
+#include <cstddef>
+
 extern "C"
 {
 #include <linux/perf_event.h>
@@ -14,7 +17,25 @@ int perf_event_paranoid();
 int perf_event_open(struct perf_event_attr* perf_attr, pid_t tid, int cpu, int group_fd,
                     unsigned long flags);
 struct perf_event_attr common_perf_event_attrs();
+// When we poll on the fd given by perf_event_open, wakeup, when the ring buffer with mmap_pages
+// data pages is 80% full. Default behaviour is to wakeup on every event, which is horrible
+// performance wise.
+void set_wakeup_watermark(struct perf_event_attr& attr, std::size_t mmap_pages);
 void perf_warn_paranoid();
+
+// After perf_event_open failed with error, decides whether to retry with attr.exclude_kernel,
+// which kernel.perf_event_paranoid > 1 still allows for unprivileged users, and sets it if so.
+// Never for events of uncore PMUs, which refuse any exclude_* flag.
+inline bool exclude_kernel_fallback(struct perf_event_attr& attr, bool uncore, int error,
+                                    int paranoid)
+{
+    if (uncore || error != EACCES || attr.exclude_kernel || paranoid <= 1)
+    {
+        return false;
+    }
+    attr.exclude_kernel = 1;
+    return true;
+}
 void perf_check_disabled();
 
 } // namespace perf
@@ -21,10 +21,16 @@
 
 #pragma once
 
+#include <lo2s/histogram.hpp>
+
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <map>
 #include <mutex>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 extern "C"
 {
@@ -44,6 +50,17 @@ public:
 
     void record_perf_wakeups(std::size_t num_wakeups);
 
+    // Statistics that are only written to the --stats-file
+    void record_monitor(const std::string& name, std::size_t num_wakeups,
+                        std::chrono::nanoseconds cpu_time);
+    void record_reader(const std::string& name, std::uint64_t records, std::uint64_t lost,
+                       std::uint64_t throttled);
+    void record_phase(const std::string& phase, std::chrono::nanoseconds duration);
+    void record_location_size(const std::string& name, std::size_t size);
+
+    // late: how many of the latencies are not in the trace, see WakeupWriter
+    void record_runqueue_latencies(const LatencyHistogram& latencies, std::uint64_t late);
+
     void set_exit_code(int exit_code);
     void set_trace_dir(const std::string& trace_dir);
 
@@ -52,6 +69,24 @@ public:
 private:
     Summary();
 
+    void write_stats_file(std::chrono::duration<double> wall_time,
+                          std::chrono::duration<double> cpu_time, std::size_t trace_size);
+
+    struct MonitorStats
+    {
+        std::string name;
+        std::size_t num_wakeups;
+        std::chrono::nanoseconds cpu_time;
+    };
+
+    struct ReaderStats
+    {
+        std::string name;
+        std::uint64_t records;
+        std::uint64_t lost;
+        std::uint64_t throttled;
+    };
+
     std::chrono::steady_clock::time_point start_wall_time_;
 
     std::atomic<std::size_t> num_wakeups_;
@@ -62,6 +97,14 @@ private:
 
     std::string trace_dir_;
 
+    std::vector<MonitorStats> monitors_;
+    std::vector<ReaderStats> readers_;
+    std::map<std::string, std::chrono::nanoseconds> phases_;
+    std::vector<std::pair<std::string, std::size_t>> location_sizes_;
+    LatencyHistogram runqueue_latencies_;
+    std::uint64_t late_runqueue_latencies_ = 0;
+    std::mutex stats_mutex_;
+
     int exit_code_;
 };
 
@@ -104,6 +104,21 @@ struct ByThreadSampleWriterTag
 };
 using ByThreadSampleWriter = SimpleKeyType<int, ByThreadSampleWriterTag>;
 
+struct ByThreadOffCpuWriterTag
+{
+};
+using ByThreadOffCpuWriter = SimpleKeyType<int, ByThreadOffCpuWriterTag>;
+
+struct ByThreadSyscallWriterTag
+{
+};
+using ByThreadSyscallWriter = SimpleKeyType<int, ByThreadSyscallWriterTag>;
+
+struct BySyscallTag
+{
+};
+using BySyscall = SimpleKeyType<int64_t, BySyscallTag>;
+
 struct ByStringTag
 {
 };
@@ -156,12 +171,14 @@ struct Holder<otf2::definition::location>
 {
     using type = otf2::lookup_definition_holder<otf2::definition::location, ByCpuSwitchWriter,
                                                 ByCpuMetricWriter, ByCpuSampleWriter,
-                                                ByThreadMetricWriter, ByThreadSampleWriter>;
+                                                ByThreadMetricWriter, ByThreadSampleWriter,
+                                                ByThreadOffCpuWriter, ByThreadSyscallWriter>;
 };
 template <>
 struct Holder<otf2::definition::region>
 {
-    using type = otf2::lookup_definition_holder<otf2::definition::region, ByThread, ByLineInfo>;
+    using type = otf2::lookup_definition_holder<otf2::definition::region, ByThread, ByLineInfo,
+                                                BySyscall>;
 };
 template <>
 struct Holder<otf2::definition::calling_context>
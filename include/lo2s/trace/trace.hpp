@@ -30,6 +30,8 @@
 
 #include <otf2xx/otf2.hpp>
 
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <mutex>
 #include <unordered_map>
@@ -107,10 +109,15 @@ public:
     otf2::writer::local& thread_sample_writer(pid_t pid, pid_t tid);
     otf2::writer::local& cpu_sample_writer(int cpuid);
     otf2::writer::local& thread_metric_writer(pid_t pid, pid_t tid);
+    otf2::writer::local& thread_off_cpu_writer(pid_t pid, pid_t tid);
+    otf2::writer::local& thread_syscall_writer(pid_t pid, pid_t tid);
     otf2::writer::local& named_metric_writer(const std::string& name);
     otf2::writer::local& cpu_metric_writer(int cpuid);
     otf2::writer::local& cpu_switch_writer(int cpuid);
 
+    // The region of a system call, named after it and created on first use
+    const otf2::definition::region& syscall_region(int64_t nr);
+
     otf2::definition::metric_member
     metric_member(const std::string& name, const std::string& description,
                   otf2::common::metric_mode mode, otf2::common::type value_type,
@@ -141,6 +148,128 @@ public:
         }
         return cpuid_metric_class_;
     }
+    otf2::definition::metric_class reader_stats_metric_class()
+    {
+        if (!reader_stats_metric_class_)
+        {
+            reader_stats_metric_class_ = registry_.create<otf2::definition::metric_class>(
+                otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+            reader_stats_metric_class_->add_member(metric_member(
+                "lost records", "Records the kernel could not write into the full ring buffer",
+                otf2::common::metric_mode::accumulated_start, otf2::common::type::uint64, "#"));
+            reader_stats_metric_class_->add_member(metric_member(
+                "throttle records", "Throttle and unthrottle records of the sampled events",
+                otf2::common::metric_mode::accumulated_start, otf2::common::type::uint64, "#"));
+            reader_stats_metric_class_->add_member(metric_member(
+                "ring buffer fill", "Fill level of the ring buffer at the readout",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::Double, "%"));
+            reader_stats_metric_class_->add_member(metric_member(
+                "ring buffer size", "Size of the data area of the ring buffer",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, "B"));
+            reader_stats_metric_class_->add_member(metric_member(
+                "readout duration", "Time spent reading the ring buffer",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, "ns"));
+        }
+        return reader_stats_metric_class_;
+    }
+
+    otf2::definition::metric_class memory_access_metric_class()
+    {
+        if (!memory_access_metric_class_)
+        {
+            memory_access_metric_class_ = registry_.create<otf2::definition::metric_class>(
+                otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+            memory_access_metric_class_->add_member(metric_member(
+                "data address", "Address of the sampled memory access",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, "address"));
+            memory_access_metric_class_->add_member(metric_member(
+                "access latency", "Latency of the sampled memory access",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, "cycles"));
+            memory_access_metric_class_->add_member(metric_member(
+                "memory level",
+                "Where the access was served from: 1 L1, 2 LFB, 3 L2, 4 L3, 5 local RAM, 6 remote "
+                "cache, 7 remote RAM, 8 other, 0 unknown",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, ""));
+            memory_access_metric_class_->add_member(metric_member(
+                "data region",
+                "Mapping of the data address: 1 heap, 2 stack, 3 file, 4 anonymous, 0 unknown",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, ""));
+        }
+        return memory_access_metric_class_;
+    }
+
+    otf2::definition::metric_class sample_group_metric_class()
+    {
+        if (!sample_group_metric_class_)
+        {
+            sample_group_metric_class_ = registry_.create<otf2::definition::metric_class>(
+                otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+            sample_group_metric_class_->add_member(
+                metric_member(config().sampling_event, "events since the previous sample",
+                              otf2::common::metric_mode::absolute_last,
+                              otf2::common::type::Double, "#"));
+            for (const auto& event : config().sampling_group_events)
+            {
+                sample_group_metric_class_->add_member(
+                    metric_member(event, "events since the previous sample",
+                                  otf2::common::metric_mode::absolute_last,
+                                  otf2::common::type::Double, "#"));
+            }
+        }
+        return sample_group_metric_class_;
+    }
+
+    otf2::definition::metric_class sampling_period_metric_class()
+    {
+        if (!sampling_period_metric_class_)
+        {
+            sampling_period_metric_class_ = registry_.create<otf2::definition::metric_class>(
+                otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+            sampling_period_metric_class_->add_member(metric_member(
+                "sampling period", "Number of events between two samples",
+                otf2::common::metric_mode::absolute_next, otf2::common::type::uint64, "#"));
+        }
+        return sampling_period_metric_class_;
+    }
+
+    otf2::definition::metric_class runqueue_latency_metric_class()
+    {
+        if (!runqueue_latency_metric_class_)
+        {
+            runqueue_latency_metric_class_ = registry_.create<otf2::definition::metric_class>(
+                otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+            runqueue_latency_metric_class_->add_member(metric_member(
+                "runqueue latency", "Time from the wakeup of a thread until it runs",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, "ns"));
+            runqueue_latency_metric_class_->add_member(metric_member(
+                "woken thread", "Thread that was switched in",
+                otf2::common::metric_mode::absolute_point, otf2::common::type::uint64, "tid"));
+        }
+        return runqueue_latency_metric_class_;
+    }
+
+    otf2::definition::metric_class monitor_overhead_metric_class()
+    {
+        if (!monitor_overhead_metric_class_)
+        {
+            monitor_overhead_metric_class_ = registry_.create<otf2::definition::metric_class>(
+                otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+            monitor_overhead_metric_class_->add_member(metric_member(
+                "CPU time", "CPU time used by the monitoring thread",
+                otf2::common::metric_mode::accumulated_start, otf2::common::type::uint64, "ns"));
+            monitor_overhead_metric_class_->add_member(metric_member(
+                "wakeups", "Wakeups of the monitoring thread",
+                otf2::common::metric_mode::accumulated_start, otf2::common::type::uint64, "#"));
+            monitor_overhead_metric_class_->add_member(metric_member(
+                "records", "perf records read by the monitoring thread",
+                otf2::common::metric_mode::accumulated_start, otf2::common::type::uint64, "#"));
+            monitor_overhead_metric_class_->add_member(metric_member(
+                "record bytes", "Size of the perf records read by the monitoring thread",
+                otf2::common::metric_mode::accumulated_start, otf2::common::type::uint64, "B"));
+        }
+        return monitor_overhead_metric_class_;
+    }
+
     otf2::definition::metric_class perf_metric_class()
     {
         if (!perf_metric_class_)
@@ -151,25 +280,38 @@ public:
                 perf::counter::requested_counters();
             if (!counter_collection.counters.empty())
             {
-                perf_metric_class_->add_member(metric_member(
-                    counter_collection.leader.name, counter_collection.leader.name,
-                    otf2::common::metric_mode::accumulated_start, otf2::common::type::Double, "#"));
+                if (!config().derived_metrics_only)
+                {
+                    const auto& leader = counter_collection.leader;
+                    perf_metric_class_->add_member(
+                        metric_member(leader.name, leader.name,
+                                      otf2::common::metric_mode::accumulated_start,
+                                      otf2::common::type::Double, "#"));
+
+                    for (const auto& counter : counter_collection.counters)
+                    {
+                        perf_metric_class_->add_member(
+                            metric_member(counter.name, counter.name,
+                                          otf2::common::metric_mode::accumulated_start,
+                                          otf2::common::type::Double, "#"));
+                    }
+
+                    perf_metric_class_->add_member(
+                        metric_member("time_enabled", "time event active",
+                                      otf2::common::metric_mode::accumulated_start,
+                                      otf2::common::type::uint64, "ns"));
+                    perf_metric_class_->add_member(
+                        metric_member("time_running", "time event on CPU",
+                                      otf2::common::metric_mode::accumulated_start,
+                                      otf2::common::type::uint64, "ns"));
+                }
 
-                for (const auto& counter : counter_collection.counters)
+                for (const auto& derived : counter_collection.derived_metrics)
                 {
                     perf_metric_class_->add_member(metric_member(
-                        counter.name, counter.name, otf2::common::metric_mode::accumulated_start,
-                        otf2::common::type::Double, "#"));
+                        derived.name(), derived.expression(),
+                        otf2::common::metric_mode::absolute_last, otf2::common::type::Double, ""));
                 }
-
-                perf_metric_class_->add_member(
-                    metric_member("time_enabled", "time event active",
-                                  otf2::common::metric_mode::accumulated_start,
-                                  otf2::common::type::uint64, "ns"));
-                perf_metric_class_->add_member(
-                    metric_member("time_running", "time event on CPU",
-                                  otf2::common::metric_mode::accumulated_start,
-                                  otf2::common::type::uint64, "ns"));
             }
         }
         return perf_metric_class_;
@@ -177,6 +319,11 @@ public:
 
     otf2::definition::metric_class& tracepoint_metric_class(const std::string& event_name);
 
+    // The requested uncore events of the given PMU, in the order of
+    // perf::counter::requested_counters().uncore_counters, followed by time_enabled and
+    // time_running
+    otf2::definition::metric_class& uncore_metric_class(const std::string& pmu);
+
     const otf2::definition::interrupt_generator& interrupt_generator() const
     {
         return interrupt_generator_;
@@ -229,10 +376,25 @@ private:
 
     void add_lo2s_property(const std::string& name, const std::string& value);
 
+    otf2::writer::local& location_writer(const otf2::definition::location& location);
+
 private:
     static constexpr pid_t METRIC_PID = 0;
 
+    // Reports the time it took to write the definitions and the size of the files of each
+    // location to the summary. Declared before archive_, so that it is destroyed after the
+    // archive has been closed.
+    struct ArchiveStats
+    {
+        ~ArchiveStats();
+
+        std::string trace_name;
+        std::map<std::uint64_t, std::string> locations;
+        std::chrono::steady_clock::time_point close_start;
+    };
+
     std::string trace_name_;
+    ArchiveStats archive_stats_;
     otf2::writer::Archive<otf2::lookup_registry<Holder>> archive_;
     otf2::lookup_registry<Holder>& registry_;
 
@@ -248,11 +410,24 @@ private:
     std::map<pid_t, std::string> thread_names_;
     std::map<pid_t, IpCctxEntry> calling_context_tree_;
 
+    std::chrono::nanoseconds cctx_merge_time_{ 0 };
+    std::chrono::nanoseconds symbolization_time_{ 0 };
+
     otf2::definition::comm_locations_group& comm_locations_group_;
     otf2::definition::regions_group& lo2s_regions_group_;
+    otf2::definition::regions_group& syscall_regions_group_;
 
     otf2::definition::detail::weak_ref<otf2::definition::metric_class> cpuid_metric_class_;
     otf2::definition::detail::weak_ref<otf2::definition::metric_class> perf_metric_class_;
+    otf2::definition::detail::weak_ref<otf2::definition::metric_class> reader_stats_metric_class_;
+    otf2::definition::detail::weak_ref<otf2::definition::metric_class>
+        monitor_overhead_metric_class_;
+    otf2::definition::detail::weak_ref<otf2::definition::metric_class>
+        sampling_period_metric_class_;
+    otf2::definition::detail::weak_ref<otf2::definition::metric_class> sample_group_metric_class_;
+    otf2::definition::detail::weak_ref<otf2::definition::metric_class> memory_access_metric_class_;
+    otf2::definition::detail::weak_ref<otf2::definition::metric_class>
+        runqueue_latency_metric_class_;
 
     const otf2::definition::system_tree_node& system_tree_root_node_;
 };
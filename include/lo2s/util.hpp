@@ -26,6 +26,7 @@
 #include <chrono>
 #include <fstream>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 
@@ -74,8 +75,13 @@ std::string get_process_comm(pid_t pid);
 std::string get_task_comm(pid_t pid, pid_t task);
 
 std::chrono::duration<double> get_cpu_time();
+// Maximum resident set size of lo2s in bytes
+std::size_t get_peak_rss();
 std::string get_datetime();
 
+// Parses lists like "0-3,8,10-11" as found in sysfs
+std::set<uint32_t> parse_list(const std::string& list);
+
 const struct ::utsname& get_uname();
 
 template <typename T>
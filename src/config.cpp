@@ -162,7 +162,12 @@ void parse_program_options(int argc, const char** argv)
     bool list_clockids, list_events, list_tracepoints, list_knobs;
     std::uint64_t read_interval_ms;
     std::uint64_t perf_read_interval_ms;
+    std::uint64_t reorder_window_us;
+    std::uint64_t syscall_min_duration_us;
     std::uint64_t metric_count, metric_frequency = 10;
+    std::string metric_group_rotation;
+    std::string readout_phase;
+    std::string call_graph_mode;
     std::vector<std::string> x86_adapt_knobs;
 
     std::string requested_clock_name;
@@ -181,6 +186,10 @@ void parse_program_options(int argc, const char** argv)
             po::value(&config.trace_path)
                 ->value_name("PATH"),
             "Output trace directory. Defaults to lo2s_trace_{DATE} if not specified.")
+        ("stats-file",
+            po::value(&config.stats_file)
+                ->value_name("PATH"),
+            "Write statistics about the measurement as JSON to PATH.")
         ("quiet,q",
             po::bool_switch(&config.quiet),
             "Suppress output.")
@@ -191,8 +200,14 @@ void parse_program_options(int argc, const char** argv)
         ("mmap-pages,m",
             po::value(&config.mmap_pages)
                 ->value_name("PAGES")
-                ->default_value(16),
-            "Number of pages to be used by internal buffers.")
+                ->default_value(0),
+            "Number of pages to be used by internal buffers, 0 sizes them automatically to fit into kernel.perf_event_mlock_kb.")
+        ("reader-stats",
+            po::bool_switch(&config.reader_stats),
+            "Record lost records, fill level and readout duration of each internal buffer.")
+        ("monitor-stats",
+            po::bool_switch(&config.monitor_stats),
+            "Record CPU time, wakeups and processed records of each lo2s monitoring thread.")
         ("readout-interval,i",
             po::value(&read_interval_ms)
                 ->value_name("MSEC")
@@ -203,6 +218,16 @@ void parse_program_options(int argc, const char** argv)
                 ->value_name("MSEC")
                 ->default_value(0),
             "Maximum amount of time between readouts of perf based monitors, i.e. sampling, metrics, tracepoints. 0 means interval based readouts are disabled ")
+        ("readout-phase",
+            po::value(&readout_phase)
+                ->value_name("POLICY")
+                ->default_value("sync"),
+            "When the interval readouts happen: \"sync\" reads all buffers at the same time, \"stagger\" spreads the readouts over the interval.")
+        ("reader-threads",
+            po::value(&config.reader_threads)
+                ->value_name("N")
+                ->default_value(0),
+            "Number of threads that read all internal buffers. 0 uses one thread per monitored CPU, thread and metric source.")
         ("clockid,k",
             po::value(&requested_clock_name)
                 ->value_name("CLOCKID")
@@ -256,9 +281,36 @@ void parse_program_options(int argc, const char** argv)
                 ->value_name("N")
                 ->default_value(11010113),
             "Sampling period (in number of events specified by -e).")
+        ("frequency,F",
+            po::value(&config.sampling_frequency)
+                ->value_name("HZ"),
+            "Sampling frequency, the kernel adjusts the sampling period to take HZ samples per second. Overrides -c.")
+        ("adaptive-period",
+            po::bool_switch(&config.adaptive_period),
+            "Raise the sampling period while samples are lost and lower it again once the load drops.")
+        ("memory-sampling",
+            po::bool_switch(&config.memory_sampling),
+            "Record data address, latency and data source of sampled memory accesses. Samples cpu/mem-loads/ unless -e is given.")
+        ("sample-group-event",
+            po::value(&config.sampling_group_events)
+                ->value_name("EVENT"),
+            "Read this event with every instruction sample and attribute it to the sampled context. May be specified multiple times.")
         ("call-graph,g",
             po::bool_switch(&config.enable_cct),
             "Record call stack of instruction samples.")
+        ("call-graph-mode",
+            po::value(&call_graph_mode)
+                ->value_name("MODE")
+                ->default_value("fp"),
+            "How call stacks are recorded: \"fp\" follows the frame pointers, \"dwarf\" unwinds a copy of the user stack, \"lbr\" uses the last branch records of the CPU. \"dwarf\" and \"lbr\" imply -g.")
+        ("stack-dump-size",
+            po::value(&config.stack_dump_size)
+                ->value_name("BYTES")
+                ->default_value(8192),
+            "Size of the copy of the user stack taken with each sample for --call-graph-mode dwarf.")
+        ("off-cpu",
+            po::bool_switch(&config.off_cpu),
+            "Record the call stack a thread is switched out in and attribute the time until it runs again to that stack (process-monitoring mode only).")
         ("no-ip,n",
             po::bool_switch(&config.suppress_ip),
             "Do not record instruction pointers [NOT CURRENTLY SUPPORTED]")
@@ -268,6 +320,16 @@ void parse_program_options(int argc, const char** argv)
         ("no-disassemble",
             po::bool_switch(&no_disassemble),
             "Disable augmentation of samples with instructions.")
+        ("reorder-window",
+            po::value(&reorder_window_us)
+                ->value_name("USEC")
+                ->default_value(1000),
+            "Time span within which out-of-order samples are sorted before they are written. 0 disables reordering.")
+        ("reorder-capacity",
+            po::value(&config.reorder_capacity)
+                ->value_name("N")
+                ->default_value(1024),
+            "Maximum number of records held back for reordering per sampling location.")
         ("kernel",
             po::bool_switch(&kernel),
             "Include events happening in kernel space (default).")
@@ -279,7 +341,21 @@ void parse_program_options(int argc, const char** argv)
         ("tracepoint,t",
             po::value(&config.tracepoint_events)
                 ->value_name("TRACEPOINT"),
-            "Enable global recording of a raw tracepoint event (usually requires root).");
+            "Enable global recording of a raw tracepoint event (usually requires root). A "
+            "filter can be appended as in \"sched:sched_switch/prev_pid==1234/\".")
+        ("wakeup-latency",
+            po::bool_switch(&config.wakeup_latency),
+            "Record the runqueue latency of every thread from its wakeup until it runs, from the "
+            "sched_wakeup and sched_switch tracepoints (usually requires root).")
+        ("syscalls",
+            po::bool_switch(&config.syscalls),
+            "Record the system calls of the monitored threads as regions, from the raw_syscalls "
+            "tracepoints (process-monitoring mode only, usually requires root).")
+        ("syscall-min-duration",
+            po::value(&syscall_min_duration_us)
+                ->value_name("USEC")
+                ->default_value(0),
+            "Only record system calls that take at least USEC microseconds.");
 
     perf_metric_options.add_options()
         ("metric-event,E",
@@ -300,7 +376,25 @@ void parse_program_options(int argc, const char** argv)
         ("metric-frequency",
             po::value(&metric_frequency)
                 ->value_name("HZ"),
-            "Number of metric buffer reads per second. Can not be used with --metric-leader");
+            "Number of metric buffer reads per second. Can not be used with --metric-leader")
+        ("metric-group-rotation",
+            po::value(&metric_group_rotation)
+                ->value_name("POLICY")
+                ->default_value("multiplex"),
+            "How metric events that do not fit into one counter group share the hardware: \"multiplex\" rotates all groups, \"pin-first\" keeps the first group scheduled.")
+        ("derived-metric",
+            po::value(&config.derived_metrics)
+                ->value_name("NAME=EXPR"),
+            "Record a metric computed from the metric events of each readout, e.g. \"ipc={instructions}/{cpu-cycles}\".")
+        ("derived-metrics-only",
+            po::bool_switch(&config.derived_metrics_only),
+            "Only record derived metrics, not the raw metric events.")
+        ("metric-rdpmc",
+            po::bool_switch(&config.metric_use_rdpmc),
+            "Read metric events from userspace with rdpmc every --readout-interval instead of sampling the metric leader (system-monitoring mode only).")
+        ("metric-counting",
+            po::bool_switch(&config.metric_counting),
+            "Read metric events with read() every --readout-interval instead of sampling the metric leader.");
 
     x86_adapt_options.add_options()
         ("x86-adapt-knob,x",
@@ -478,11 +572,46 @@ void parse_program_options(int argc, const char** argv)
         std::exit(EXIT_FAILURE);
     }
 
-    if (config.sampling)
+    if (config.sampling || config.off_cpu)
     {
         perf::perf_check_disabled();
     }
 
+    if (config.syscalls && config.monitor_type != lo2s::MonitorType::PROCESS)
+    {
+        Log::fatal() << "--syscalls is only supported in process-monitoring mode";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (config.off_cpu)
+    {
+#ifdef USE_PERF_RECORD_SWITCH
+        if (config.monitor_type != lo2s::MonitorType::PROCESS)
+        {
+            Log::fatal() << "--off-cpu is only supported in process-monitoring mode";
+            std::exit(EXIT_FAILURE);
+        }
+#else
+        Log::fatal() << "--off-cpu is not available, lo2s was built without "
+                        "USE_PERF_RECORD_SWITCH";
+        std::exit(EXIT_FAILURE);
+#endif
+    }
+
+    if (config.memory_sampling)
+    {
+        if (!config.sampling)
+        {
+            Log::fatal() << "--memory-sampling requires instruction sampling";
+            std::exit(EXIT_FAILURE);
+        }
+        if (vm["event"].defaulted())
+        {
+            // Precise load event with a latency threshold on Intel CPUs
+            config.sampling_event = "cpu/mem-loads/";
+        }
+    }
+
     if (config.sampling && !perf::EventProvider::has_event(config.sampling_event))
     {
         lo2s::Log::fatal() << "requested sampling event \'" << config.sampling_event
@@ -490,6 +619,43 @@ void parse_program_options(int argc, const char** argv)
         std::exit(EXIT_FAILURE); // hmm...
     }
 
+    for (const auto& event : config.sampling_group_events)
+    {
+        if (!config.sampling)
+        {
+            Log::fatal() << "--sample-group-event requires instruction sampling";
+            std::exit(EXIT_FAILURE);
+        }
+        if (!perf::EventProvider::has_event(event))
+        {
+            Log::fatal() << "requested sample group event \'" << event << "\' is not available!";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    config.sampling_use_frequency = vm.count("frequency") > 0;
+    if (config.sampling_use_frequency)
+    {
+        if (!vm["count"].defaulted())
+        {
+            Log::fatal() << "--count and --frequency cannot be used together";
+            std::exit(EXIT_FAILURE);
+        }
+
+        if (config.sampling_frequency == 0)
+        {
+            Log::fatal() << "--frequency should not be zero";
+            std::exit(EXIT_FAILURE);
+        }
+
+        if (config.adaptive_period)
+        {
+            Log::warn() << "--adaptive-period has no effect with --frequency, the kernel already "
+                           "adapts the sampling period";
+            config.adaptive_period = false;
+        }
+    }
+
     // time synchronization
     config.use_clockid = false;
     try
@@ -527,6 +693,8 @@ void parse_program_options(int argc, const char** argv)
 
     config.read_interval = std::chrono::milliseconds(read_interval_ms);
     config.perf_read_interval = std::chrono::milliseconds(perf_read_interval_ms);
+    config.reorder_window = std::chrono::microseconds(reorder_window_us);
+    config.syscall_min_duration = std::chrono::microseconds(syscall_min_duration_us);
 
     if (no_disassemble && disassemble)
     {
@@ -603,6 +771,142 @@ void parse_program_options(int argc, const char** argv)
         config.metric_count = metric_count;
     }
 
+    if (call_graph_mode == "fp")
+    {
+        config.call_graph_mode = CallGraphMode::FRAME_POINTER;
+    }
+    else if (call_graph_mode == "dwarf")
+    {
+#ifdef HAVE_LIBDW
+        config.call_graph_mode = CallGraphMode::DWARF;
+        config.enable_cct = true;
+
+        // The kernel wants a multiple of 8, at most just below 64 KiB
+        config.stack_dump_size = (config.stack_dump_size + 7) & ~7U;
+        if (config.stack_dump_size == 0 || config.stack_dump_size > 65528)
+        {
+            Log::fatal() << "--stack-dump-size must be between 1 and 65528 bytes";
+            std::exit(EXIT_FAILURE);
+        }
+#else
+        Log::fatal() << "--call-graph-mode dwarf is not available, lo2s was built without libdw";
+        std::exit(EXIT_FAILURE);
+#endif
+    }
+    else if (call_graph_mode == "lbr")
+    {
+        config.call_graph_mode = CallGraphMode::LBR;
+        config.enable_cct = true;
+    }
+    else
+    {
+        Log::fatal() << "Unknown --call-graph-mode '" << call_graph_mode
+                     << "', expected 'fp', 'dwarf' or 'lbr'";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (readout_phase == "sync")
+    {
+        config.readout_phase = ReadoutPhase::SYNC;
+    }
+    else if (readout_phase == "stagger")
+    {
+        config.readout_phase = ReadoutPhase::STAGGER;
+    }
+    else
+    {
+        Log::fatal() << "Unknown --readout-phase policy '" << readout_phase
+                     << "', expected 'sync' or 'stagger'";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (metric_group_rotation == "multiplex")
+    {
+        config.metric_group_rotation = CounterGroupRotation::MULTIPLEX;
+    }
+    else if (metric_group_rotation == "pin-first")
+    {
+        config.metric_group_rotation = CounterGroupRotation::PIN_FIRST;
+    }
+    else
+    {
+        Log::fatal() << "Unknown --metric-group-rotation policy '" << metric_group_rotation
+                     << "', expected 'multiplex' or 'pin-first'";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (config.metric_use_rdpmc && config.monitor_type != lo2s::MonitorType::CPU_SET)
+    {
+        Log::warn() << "--metric-rdpmc is only supported in system-monitoring mode, using "
+                       "--metric-counting instead.";
+        config.metric_use_rdpmc = false;
+        config.metric_counting = true;
+    }
+    if (config.metric_use_rdpmc || config.metric_counting)
+    {
+        if (vm.count("metric-count") || vm.count("metric-frequency"))
+        {
+            Log::warn() << "--metric-count and --metric-frequency have no effect when metric "
+                           "events are read on the readout timer.";
+        }
+        // Without a sampling leader, the timer is the only trigger for counter readouts
+        if (config.perf_read_interval.count() == 0)
+        {
+            config.perf_read_interval = config.read_interval;
+        }
+    }
+#ifndef __x86_64__
+    if (config.metric_use_rdpmc)
+    {
+        Log::warn() << "rdpmc is not supported on this architecture, metric events will be read "
+                       "with read() instead.";
+    }
+#endif
+
+    // The workers of the reader pool serve the monitors of many CPUs and are not pinned to the CPU
+    // of the monitor they read, nor is their overhead attributable to a single monitor
+    if (config.reader_threads > 0 && config.metric_use_rdpmc)
+    {
+        Log::fatal() << "--metric-rdpmc can not be combined with --reader-threads, rdpmc only "
+                        "works on the CPU of the counters";
+        std::exit(EXIT_FAILURE);
+    }
+    if (config.reader_threads > 0 && config.monitor_stats)
+    {
+        Log::fatal() << "--monitor-stats can not be combined with --reader-threads, the overhead "
+                        "of a reader thread is shared by all monitors it serves";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (config.derived_metrics_only && config.derived_metrics.empty())
+    {
+        Log::fatal() << "--derived-metrics-only requires at least one --derived-metric";
+        std::exit(EXIT_FAILURE);
+    }
+
+    for (const auto& tracepoint : config.tracepoint_events)
+    {
+        try
+        {
+            perf::tracepoint::EventSpec spec(tracepoint);
+            if (!spec.filter.empty())
+            {
+                perf::tracepoint::EventFormat(spec.name).validate_filter(spec.filter);
+            }
+        }
+        catch (const perf::tracepoint::InvalidFilter& e)
+        {
+            Log::fatal() << "Invalid tracepoint filter: " << e.what();
+            std::exit(EXIT_FAILURE);
+        }
+        catch (const perf::tracepoint::EventFormat::ParseError& e)
+        {
+            // Reported when the tracepoint monitors are set up
+            Log::debug() << "Can not validate the filter of tracepoint '" << tracepoint
+                         << "': " << e.what();
+        }
+    }
+
     config.exclude_kernel = false;
     if (kernel && no_kernel)
     {
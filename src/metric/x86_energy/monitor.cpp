@@ -30,7 +30,7 @@ void Monitor::initialize_thread()
     try_pin_to_cpu(cpu_);
 }
 
-void Monitor::monitor([[maybe_unused]] int fd)
+void Monitor::monitor()
 {
     metric_event_.timestamp(time::now());
     metric_event_.raw_values()[0] = counter_.read();
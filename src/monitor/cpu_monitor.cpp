@@ -40,11 +40,25 @@ CpuMonitor::CpuMonitor(int cpuid, MainMonitor& parent)
   switch_writer_(cpuid, parent.trace())
 #endif
 {
-    if (!perf::counter::requested_counters().counters.empty())
+    if (!perf::counter::requested_counters().counters.empty() && config().metric_use_rdpmc)
+    {
+        userspace_counter_writer_ = std::make_unique<perf::counter::UserspaceWriter>(
+            cpuid, parent.trace().cpu_metric_writer(cpuid), parent);
+    }
+    else if (!perf::counter::requested_counters().counters.empty() && config().metric_counting)
+    {
+        auto& writer = parent.trace().cpu_metric_writer(cpuid);
+        counting_writer_ = std::make_unique<perf::counter::CountingWriter>(
+            -1, cpuid, writer,
+            parent.trace().metric_instance(parent.trace().perf_metric_class(), writer.location(),
+                                           parent.trace().cpu_switch_writer(cpuid).location()),
+            false);
+    }
+    else if (!perf::counter::requested_counters().counters.empty())
     {
         counter_writer_ = std::make_unique<perf::counter::CpuWriter>(
             cpuid, parent.trace().cpu_metric_writer(cpuid), parent);
-        add_fd(counter_writer_->fd());
+        add_fd(counter_writer_->fd(), [this]() { counter_writer_->read(); });
     }
 #ifndef USE_PERF_RECORD_SWITCH
     if (config().sampling)
@@ -52,10 +66,10 @@ CpuMonitor::CpuMonitor(int cpuid, MainMonitor& parent)
     {
         sample_writer_ = std::make_unique<perf::sample::Writer>(
             -1, -1, cpuid, parent, parent.trace(), parent.trace().cpu_sample_writer(cpuid), false);
-        add_fd(sample_writer_->fd());
+        add_fd(sample_writer_->fd(), [this]() { sample_writer_->read(); });
     }
 #ifndef USE_PERF_RECORD_SWITCH
-    add_fd(switch_writer_.fd());
+    add_fd(switch_writer_.fd(), [this]() { switch_writer_.read(); });
 #endif
 }
 void CpuMonitor::initialize_thread()
@@ -70,24 +84,16 @@ void CpuMonitor::finalize_thread()
     }
 }
 
-void CpuMonitor::monitor(int fd)
+void CpuMonitor::monitor()
 {
-    if (counter_writer_ &&
-        (fd == timer_pfd().fd || fd == stop_pfd().fd || counter_writer_->fd() == fd))
+    if (userspace_counter_writer_)
     {
-        counter_writer_->read();
+        userspace_counter_writer_->read();
     }
-    if (sample_writer_ &&
-        (fd == timer_pfd().fd || fd == stop_pfd().fd || sample_writer_->fd() == fd))
+    if (counting_writer_)
     {
-        sample_writer_->read();
+        counting_writer_->read();
     }
-#ifndef USE_PERF_RECORD_SWITCH
-    if (switch_writer_.fd() == fd || fd == timer_pfd().fd || fd == stop_pfd().fd)
-    {
-        switch_writer_.read();
-    }
-#endif
 }
 } // namespace monitor
 } // namespace lo2s
@@ -23,10 +23,14 @@
 
 #include <lo2s/config.hpp>
 #include <lo2s/log.hpp>
+#include <lo2s/monitor/reader_pool.hpp>
+#include <lo2s/perf/counter/counter_collection.hpp>
 #include <lo2s/perf/time/converter.hpp>
 #include <lo2s/topology.hpp>
 #include <lo2s/trace/trace.hpp>
 
+#include <set>
+
 namespace lo2s
 {
 namespace monitor
@@ -40,6 +44,11 @@ MainMonitor::MainMonitor() : trace_(), metrics_(trace_)
 
     metrics_.start();
 
+    if (config().reader_threads > 0)
+    {
+        ReaderPool::instance().start(trace_, config().reader_threads);
+    }
+
     // notify the trace, that we are ready to start. That means, get_time() of this call will be
     // the first possible timestamp in the trace
     trace_.begin_record();
@@ -47,7 +56,7 @@ MainMonitor::MainMonitor() : trace_(), metrics_(trace_)
     // TODO we can still have events earlier due to different timers.
 
     // try to initialize raw counter metrics
-    if (!config().tracepoint_events.empty())
+    if (!config().tracepoint_events.empty() || config().wakeup_latency)
     {
         try
         {
@@ -64,6 +73,30 @@ MainMonitor::MainMonitor() : trace_(), metrics_(trace_)
         }
     }
 
+    // Uncore events are only requested in system-monitoring mode, one monitor per CPU in the
+    // cpumasks of their PMUs
+    const auto& uncore_counters = perf::counter::requested_counters().uncore_counters;
+    if (!uncore_counters.empty())
+    {
+        try
+        {
+            std::set<uint32_t> cpus;
+            for (const auto& counter : uncore_counters)
+            {
+                cpus.insert(counter.cpus.begin(), counter.cpus.end());
+            }
+            for (auto cpu : cpus)
+            {
+                uncore_monitors_.emplace_back(std::make_unique<UncoreMonitor>(trace_, cpu));
+                uncore_monitors_.back()->start();
+            }
+        }
+        catch (std::exception& e)
+        {
+            Log::warn() << "Failed to initialize uncore metric events: " << e.what();
+        }
+    }
+
 #ifdef HAVE_X86_ADAPT
     if (!config().x86_adapt_knobs.empty())
     {
@@ -123,6 +156,11 @@ MainMonitor::~MainMonitor()
     }
 #endif
 
+    for (auto& uncore_monitor : uncore_monitors_)
+    {
+        uncore_monitor->stop();
+    }
+
     if (!tracepoint_monitors_.empty())
     {
         for (auto& tracepoint_monitor : tracepoint_monitors_)
@@ -136,6 +174,9 @@ MainMonitor::~MainMonitor()
     trace_.end_record();
 
     metrics_.stop();
+
+    // All PollMonitors, including those of derived classes, are stopped by now
+    ReaderPool::instance().stop();
 }
 } // namespace monitor
 } // namespace lo2s
@@ -22,141 +22,265 @@
 #include <lo2s/config.hpp>
 #include <lo2s/error.hpp>
 #include <lo2s/monitor/poll_monitor.hpp>
+#include <lo2s/monitor/reader_pool.hpp>
+#include <lo2s/perf/event_reader.hpp>
 
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+
 extern "C"
 {
+#include <sys/epoll.h>
 #include <sys/timerfd.h>
+#include <unistd.h>
 }
 
 namespace lo2s
 {
 namespace monitor
 {
+/* Offsets the timer of each new monitor by the fractional part of n times the golden ratio of the
+ * interval. This spreads the readouts evenly over the interval, however many monitors there are
+ * in the end.
+ */
+static std::chrono::nanoseconds stagger_offset(std::chrono::nanoseconds read_interval)
+{
+    static std::atomic<std::uint64_t> num_timers(0);
+    constexpr double golden_ratio_fraction = 0.6180339887498949;
+
+    double fraction = std::fmod(num_timers++ * golden_ratio_fraction, 1.0);
+    return std::chrono::nanoseconds(
+        static_cast<std::chrono::nanoseconds::rep>(fraction * read_interval.count()));
+}
+
 PollMonitor::PollMonitor(trace::Trace& trace, const std::string& name,
                          std::chrono::nanoseconds read_interval)
-: ThreadedMonitor(trace, name)
+: ThreadedMonitor(trace, name), epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+  stop_handler_{ stop_pipe_.read_fd(), nullptr }
 {
-    pfds_.resize(2);
-    stop_pfd().fd = stop_pipe_.read_fd();
-    stop_pfd().events = POLLIN;
-    stop_pfd().revents = 0;
+    if (epoll_fd_ == -1)
+    {
+        Log::error() << "creating epoll instance failed";
+        throw_errno();
+    }
 
-    // Create and initialize timer_fd
-    struct itimerspec tspec;
-    memset(&tspec, 0, sizeof(struct itimerspec));
+    add_handler(stop_handler_, EPOLLIN);
 
-    // Set initial expiration to lowest possible value, this together with TFD_TIMER_ABSTIME should
-    // synchronize our timers
+    // Create and initialize timer_fd
     if (read_interval.count() != 0)
     {
+        struct itimerspec tspec;
+        memset(&tspec, 0, sizeof(struct itimerspec));
 
-        tspec.it_value.tv_nsec = 1;
+        // Set initial expiration to lowest possible value, this together with TFD_TIMER_ABSTIME
+        // should synchronize our timers. Staggered timers are shifted by their offset.
+        auto phase = std::chrono::nanoseconds(1);
+        if (config().readout_phase == ReadoutPhase::STAGGER)
+        {
+            phase += stagger_offset(read_interval);
+        }
+        tspec.it_value.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(phase).count();
+        tspec.it_value.tv_nsec = (phase % std::chrono::seconds(1)).count();
 
         tspec.it_interval.tv_sec =
             std::chrono::duration_cast<std::chrono::seconds>(read_interval).count();
 
         tspec.it_interval.tv_nsec = (read_interval % std::chrono::seconds(1)).count();
 
-        timer_pfd().fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-        timer_pfd().events = POLLIN;
-        timer_pfd().revents = 0;
+        timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &tspec, NULL);
 
-        timerfd_settime(timer_pfd().fd, TFD_TIMER_ABSTIME, &tspec, NULL);
+        timer_handler_.fd = timer_fd_;
+        add_handler(timer_handler_, EPOLLIN);
     }
-    else
+}
+
+PollMonitor::~PollMonitor()
+{
+    if (timer_fd_ != -1)
     {
-        // fd = -1 is just going to be ignored
-        timer_pfd().fd = -1;
-        timer_pfd().events = 0;
-        timer_pfd().revents = 0;
+        close(timer_fd_);
     }
+    close(epoll_fd_);
 }
 
-void PollMonitor::add_fd(int fd)
+void PollMonitor::add_handler(Handler& handler, std::uint32_t events)
 {
-    struct pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    pfd.revents = 0;
-    pfds_.push_back(pfd);
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = &handler;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, handler.fd, &event) == -1)
+    {
+        Log::error() << "adding fd " << handler.fd << " to epoll instance failed";
+        throw_errno();
+    }
+}
+
+void PollMonitor::add_fd(int fd, std::function<void()> read)
+{
+    auto handler = std::make_unique<Handler>(Handler{ fd, std::move(read) });
+    add_handler(*handler, EPOLLIN | EPOLLET);
+    handlers_.emplace(fd, std::move(handler));
+}
+
+void PollMonitor::remove_fd(int fd)
+{
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end())
+    {
+        return;
+    }
+
+    // Closed fds are removed by the kernel already
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+
+    it->second->removed = true;
+    removed_handlers_.emplace_back(std::move(it->second));
+    handlers_.erase(it);
+}
+
+void PollMonitor::start()
+{
+    if (ReaderPool::instance().running())
+    {
+        pooled_ = true;
+        ReaderPool::instance().add(*this);
+    }
+    else
+    {
+        ThreadedMonitor::start();
+    }
 }
 
 void PollMonitor::stop()
 {
-    if (!thread_.joinable())
+    if (!running())
     {
         Log::warn() << "Cannot stop/join PollMonitor thread not running.";
         return;
     }
 
     stop_pipe_.write();
-    thread_.join();
+    if (pooled_)
+    {
+        ReaderPool::instance().wait_finished(*this);
+        pooled_ = false;
+    }
+    else
+    {
+        thread_.join();
+    }
 }
 
-void PollMonitor::monitor()
+void PollMonitor::read_all()
 {
-    for (const auto& pfd : pfds_)
+    // Handlers may add or remove fds, which must not invalidate the iteration
+    std::vector<Handler*> handlers;
+    handlers.reserve(handlers_.size());
+    for (const auto& handler : handlers_)
+    {
+        handlers.push_back(handler.second.get());
+    }
+
+    for (auto handler : handlers)
     {
-        if (pfd.revents & POLLIN)
+        if (!handler->removed)
         {
-            monitor(pfd.fd);
+            handler->read();
         }
     }
+    monitor();
 }
 
 void PollMonitor::run()
 {
-    bool stop_requested = false;
-    do
+    while (dispatch(-1))
     {
-        auto ret = ::poll(pfds_.data(), pfds_.size(), -1);
-        num_wakeups_++;
+    }
+}
 
-        if (ret == 0)
-        {
-            throw std::runtime_error("Received poll timeout despite requesting no timeout.");
-        }
-        else if (ret < 0)
-        {
-            Log::error() << "poll failed";
-            throw_errno();
-        }
-        Log::trace() << "PollMonitor poll returned " << ret;
+bool PollMonitor::dispatch(int timeout)
+{
+    std::array<struct epoll_event, 64> events;
 
-        bool panic = false;
-        for (const auto& pfd : pfds_)
+    auto ret = epoll_wait(epoll_fd_, events.data(), events.size(), timeout);
+    // In the reader pool, the worker counts its wakeups
+    if (!pooled_)
+    {
+        count_wakeup();
+    }
+
+    if (ret == 0)
+    {
+        if (timeout == -1)
         {
-            if (pfd.revents != 0 && pfd.revents != POLLIN)
-            {
-                Log::warn() << "Poll on raw event fds got unexpected event flags: " << pfd.revents
-                            << ". Stopping raw event polling.";
-                panic = true;
-            }
+            throw std::runtime_error("Received epoll timeout despite requesting no timeout.");
         }
-        if (panic)
+        return true;
+    }
+    else if (ret < 0)
+    {
+        Log::error() << "epoll_wait failed";
+        throw_errno();
+    }
+    Log::trace() << "PollMonitor epoll_wait returned " << ret;
+
+    bool panic = false;
+    bool read_requested = false;
+    bool stop_requested = false;
+    for (int i = 0; i < ret; i++)
+    {
+        auto handler = static_cast<Handler*>(events[i].data.ptr);
+
+        if (events[i].events != EPOLLIN)
         {
+            Log::warn() << "Poll on raw event fds got unexpected event flags: "
+                        << events[i].events << ". Stopping raw event polling.";
+            panic = true;
             break;
         }
 
-        monitor();
-
-        // Flush timer
-        if (timer_pfd().revents & POLLIN)
+        if (handler == &timer_handler_)
         {
+            // Flush timer
             [[maybe_unused]] uint64_t expirations;
-            if (read(timer_pfd().fd, &expirations, sizeof(expirations)) == -1)
+            if (read(timer_fd_, &expirations, sizeof(expirations)) == -1)
             {
                 Log::error() << "Flushing timer fd failed";
                 throw_errno();
             }
+            read_requested = true;
         }
-        if (stop_pfd().revents & POLLIN)
+        else if (handler == &stop_handler_)
         {
             Log::debug() << "Requested stop of PollMonitor";
             stop_requested = true;
+            read_requested = true;
         }
-    } while (!stop_requested);
+        else if (!handler->removed)
+        {
+            handler->read();
+        }
+    }
+    if (panic)
+    {
+        removed_handlers_.clear();
+        return false;
+    }
+
+    if (read_requested)
+    {
+        perf::thread_final_readout() = stop_requested;
+        read_all();
+        perf::thread_final_readout() = false;
+    }
+
+    removed_handlers_.clear();
+    return !stop_requested;
 }
 } // namespace monitor
 } // namespace lo2s
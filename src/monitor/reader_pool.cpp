@@ -0,0 +1,221 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/monitor/reader_pool.hpp>
+
+#include <lo2s/error.hpp>
+#include <lo2s/log.hpp>
+#include <lo2s/monitor/poll_monitor.hpp>
+#include <lo2s/monitor/threaded_monitor.hpp>
+#include <lo2s/topology.hpp>
+
+#include <cerrno>
+#include <string>
+
+extern "C"
+{
+#include <sched.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+}
+
+namespace lo2s
+{
+namespace monitor
+{
+
+class ReaderPool::Worker : public ThreadedMonitor
+{
+public:
+    Worker(trace::Trace& trace, ReaderPool& pool, std::size_t index,
+           const Topology::Package& package)
+    : ThreadedMonitor(trace, std::to_string(index)), pool_(pool), package_(package)
+    {
+    }
+
+    void stop() override
+    {
+        thread_.join();
+    }
+
+    std::string group() const override
+    {
+        return "ReaderPool";
+    }
+
+protected:
+    void initialize_thread() override
+    {
+        cpu_set_t cpumask;
+        CPU_ZERO(&cpumask);
+        for (auto cpu : package_.cpu_ids)
+        {
+            CPU_SET(cpu, &cpumask);
+        }
+        if (sched_setaffinity(0, sizeof(cpumask), &cpumask) != 0)
+        {
+            Log::error() << "sched_setaffinity failed with: " << make_system_error().what();
+        }
+    }
+
+    void run() override
+    {
+        while (auto monitor = pool_.wait())
+        {
+            count_wakeup();
+            pool_.dispatch(*monitor);
+        }
+    }
+
+    void monitor() override
+    {
+    }
+
+private:
+    ReaderPool& pool_;
+    Topology::Package package_;
+};
+
+ReaderPool& ReaderPool::instance()
+{
+    static ReaderPool pool;
+    return pool;
+}
+
+ReaderPool::ReaderPool()
+{
+}
+
+ReaderPool::~ReaderPool()
+{
+    stop();
+}
+
+void ReaderPool::start(trace::Trace& trace, std::size_t num_workers)
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1)
+    {
+        Log::error() << "creating epoll instance for the reader pool failed";
+        throw_errno();
+    }
+
+    // Level-triggered and without data, so that it wakes up all workers
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_pipe_.read_fd(), &event) == -1)
+    {
+        Log::error() << "adding stop pipe to the reader pool failed";
+        throw_errno();
+    }
+
+    auto packages = Topology::instance().packages();
+    Log::debug() << "Reading perf buffers with " << num_workers << " worker thread(s) on "
+                 << packages.size() << " package(s)";
+    for (std::size_t i = 0; i < num_workers; i++)
+    {
+        workers_.emplace_back(
+            std::make_unique<Worker>(trace, *this, i, packages[i % packages.size()]));
+        workers_.back()->start();
+    }
+}
+
+void ReaderPool::stop()
+{
+    if (!running())
+    {
+        return;
+    }
+
+    stop_pipe_.write();
+    for (auto& worker : workers_)
+    {
+        worker->stop();
+    }
+    workers_.clear();
+
+    close(epoll_fd_);
+    epoll_fd_ = -1;
+}
+
+void ReaderPool::add(PollMonitor& monitor)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = &monitor;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, monitor.epoll_fd_, &event) == -1)
+    {
+        Log::error() << "adding " << monitor.name() << " to the reader pool failed";
+        throw_errno();
+    }
+}
+
+void ReaderPool::wait_finished(PollMonitor& monitor)
+{
+    std::unique_lock<std::mutex> lock(finished_mutex_);
+    finished_cv_.wait(lock, [this, &monitor]() { return finished_.count(&monitor) != 0; });
+    finished_.erase(&monitor);
+}
+
+PollMonitor* ReaderPool::wait()
+{
+    struct epoll_event event;
+    int ret;
+    do
+    {
+        ret = epoll_wait(epoll_fd_, &event, 1, -1);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret == -1)
+    {
+        Log::error() << "epoll_wait in the reader pool failed";
+        throw_errno();
+    }
+
+    return static_cast<PollMonitor*>(event.data.ptr);
+}
+
+void ReaderPool::dispatch(PollMonitor& monitor)
+{
+    if (monitor.dispatch(0))
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = &monitor;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, monitor.epoll_fd_, &event) == -1)
+        {
+            Log::error() << "re-arming " << monitor.name() << " in the reader pool failed";
+            throw_errno();
+        }
+        return;
+    }
+
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, monitor.epoll_fd_, nullptr);
+    monitor.finalize_thread();
+
+    // The monitor may be destroyed as soon as it is marked finished, so this is the last access
+    std::lock_guard<std::mutex> lock(finished_mutex_);
+    finished_.insert(&monitor);
+    finished_cv_.notify_all();
+}
+} // namespace monitor
+} // namespace lo2s
@@ -52,14 +52,44 @@ ThreadMonitor::ThreadMonitor(pid_t pid, pid_t tid, ProcessMonitor& parent_monito
         sample_writer_ = std::make_unique<perf::sample::Writer>(
             pid, tid, -1, parent_monitor, parent_monitor.trace(),
             parent_monitor.trace().thread_sample_writer(pid, tid), enable_on_exec);
-        add_fd(sample_writer_->fd());
+        add_fd(sample_writer_->fd(), [this]() {
+            if (!pooled())
+            {
+                check_affinity();
+            }
+            sample_writer_->read();
+        });
     }
-    if (!perf::counter::requested_counters().counters.empty())
+#ifdef USE_PERF_RECORD_SWITCH
+    if (config().off_cpu)
+    {
+        off_cpu_writer_ = std::make_unique<perf::sample::OffCpuWriter>(
+            pid, tid, parent_monitor, parent_monitor.trace(), enable_on_exec);
+        add_fd(off_cpu_writer_->fd(), [this]() { off_cpu_writer_->read(); });
+    }
+#endif
+    if (config().syscalls)
+    {
+        syscall_writer_ = std::make_unique<perf::tracepoint::SyscallWriter>(
+            pid, tid, parent_monitor.trace());
+        add_fd(syscall_writer_->fd(), [this]() { syscall_writer_->read(); });
+    }
+    if (!perf::counter::requested_counters().counters.empty() && config().metric_counting)
+    {
+        auto& writer = parent_monitor.trace().thread_metric_writer(pid, tid);
+        counting_writer_ = std::make_unique<perf::counter::CountingWriter>(
+            tid, -1, writer,
+            parent_monitor.trace().metric_instance(
+                parent_monitor.trace().perf_metric_class(), writer.location(),
+                parent_monitor.trace().thread_sample_writer(pid, tid).location()),
+            enable_on_exec);
+    }
+    else if (!perf::counter::requested_counters().counters.empty())
     {
         counter_writer_ = std::make_unique<perf::counter::ProcessWriter>(
             pid, tid, parent_monitor.trace().thread_metric_writer(pid, tid), parent_monitor,
             enable_on_exec);
-        add_fd(counter_writer_->fd());
+        add_fd(counter_writer_->fd(), [this]() { counter_writer_->read(); });
     }
 
     /* setup the sampling counter(s) and start a monitoring thread */
@@ -68,15 +98,23 @@ ThreadMonitor::ThreadMonitor(pid_t pid, pid_t tid, ProcessMonitor& parent_monito
 
 void ThreadMonitor::stop()
 {
-    if (!thread_.joinable())
+    if (!running())
     {
         return;
     }
 
-    stop_pipe_.write();
-    thread_.join();
+    PollMonitor::stop();
     stop_pipe_.close();
-    sample_writer_->close();
+    if (sample_writer_)
+    {
+        sample_writer_->close();
+    }
+#ifdef USE_PERF_RECORD_SWITCH
+    if (off_cpu_writer_)
+    {
+        off_cpu_writer_->close();
+    }
+#endif
 }
 
 void ThreadMonitor::check_affinity(bool force)
@@ -103,22 +141,29 @@ void ThreadMonitor::finalize_thread()
     {
         sample_writer_->end();
     }
+#ifdef USE_PERF_RECORD_SWITCH
+    if (off_cpu_writer_)
+    {
+        off_cpu_writer_->end();
+    }
+#endif
+    if (syscall_writer_)
+    {
+        syscall_writer_->end();
+    }
 }
 
-void ThreadMonitor::monitor(int fd)
+void ThreadMonitor::monitor()
 {
-    check_affinity();
-
-    if (sample_writer_ &&
-        (fd == timer_pfd().fd || fd == stop_pfd().fd || sample_writer_->fd() == fd))
+    // Workers of the reader pool serve many threads and stay on their package
+    if (!pooled())
     {
-        sample_writer_->read();
+        check_affinity();
     }
 
-    if (counter_writer_ &&
-        (fd == timer_pfd().fd || fd == stop_pfd().fd || counter_writer_->fd() == fd))
+    if (counting_writer_)
     {
-        counter_writer_->read();
+        counting_writer_->read();
     }
 }
 } // namespace monitor
@@ -21,12 +21,20 @@
 
 #include <lo2s/monitor/threaded_monitor.hpp>
 
+#include <lo2s/config.hpp>
+#include <lo2s/perf/reader_stats.hpp>
 #include <lo2s/summary.hpp>
+#include <lo2s/time/time.hpp>
 #include <lo2s/trace/trace.hpp>
 #include <lo2s/util.hpp>
 
 #include <fmt/core.h>
 
+extern "C"
+{
+#include <time.h>
+}
+
 namespace lo2s
 {
 namespace monitor
@@ -45,6 +53,17 @@ ThreadedMonitor::~ThreadedMonitor()
 void ThreadedMonitor::start()
 {
     assert(!thread_.joinable());
+
+    // The writer has to be created here rather than in the constructor, as name() is virtual
+    if (config().monitor_stats && overhead_writer_ == nullptr)
+    {
+        overhead_writer_ = &trace_.named_metric_writer(fmt::format("overhead of lo2s::{}", name()));
+        overhead_event_.emplace(otf2::chrono::genesis(),
+                                trace_.metric_instance(trace_.monitor_overhead_metric_class(),
+                                                       overhead_writer_->location(),
+                                                       overhead_writer_->location()));
+    }
+
     thread_ = std::thread([this]() { this->thread_main(); });
 }
 
@@ -62,9 +81,51 @@ void ThreadedMonitor::thread_main()
     register_thread();
     initialize_thread();
     Log::debug() << name() << " starting.";
+    write_overhead();
     run();
     Log::debug() << name() << " ending.";
     finalize_thread();
+    write_overhead();
+
+    struct timespec cpu_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+    summary().record_monitor(name(), num_wakeups_,
+                             std::chrono::seconds(cpu_time.tv_sec) +
+                                 std::chrono::nanoseconds(cpu_time.tv_nsec));
+}
+
+void ThreadedMonitor::count_wakeup()
+{
+    num_wakeups_++;
+
+    if (overhead_writer_ != nullptr &&
+        lo2s::time::now() - last_overhead_write_ >= config().read_interval)
+    {
+        write_overhead();
+    }
+}
+
+void ThreadedMonitor::write_overhead()
+{
+    if (overhead_writer_ == nullptr)
+    {
+        return;
+    }
+
+    struct timespec cpu_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+    const auto& readouts = perf::thread_readout_totals();
+
+    last_overhead_write_ = lo2s::time::now();
+    overhead_event_->timestamp(last_overhead_write_);
+
+    auto& values = overhead_event_->raw_values();
+    values[0] = static_cast<std::uint64_t>(cpu_time.tv_sec * 1000000000ull + cpu_time.tv_nsec);
+    values[1] = static_cast<std::uint64_t>(num_wakeups_);
+    values[2] = readouts.records;
+    values[3] = readouts.bytes;
+
+    *overhead_writer_ << *overhead_event_;
 }
 
 void ThreadedMonitor::register_thread()
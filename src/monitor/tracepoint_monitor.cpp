@@ -36,42 +36,17 @@ namespace monitor
 TracepointMonitor::TracepointMonitor(trace::Trace& trace, int cpuid)
 : monitor::PollMonitor(trace, "", config().perf_read_interval), cpu_(cpuid)
 {
-    for (const auto& event_name : config().tracepoint_events)
-    {
-        auto& mc = trace.tracepoint_metric_class(event_name);
-        perf::tracepoint::EventFormat event(event_name);
-        std::unique_ptr<perf::tracepoint::Writer> writer =
-            std::make_unique<perf::tracepoint::Writer>(cpuid, event, trace, mc);
-
-        add_fd(writer->fd());
-        perf_writers_.emplace(std::piecewise_construct, std::forward_as_tuple(writer->fd()),
-                              std::forward_as_tuple(std::move(writer)));
-    }
+    perf_writer_ = std::make_unique<perf::tracepoint::Writer>(
+        cpuid, trace, config().tracepoint_events, config().wakeup_latency);
+    add_fd(perf_writer_->fd(), [this]() { perf_writer_->read(); });
 }
 void TracepointMonitor::initialize_thread()
 {
     try_pin_to_cpu(cpu_);
 }
-void TracepointMonitor::monitor(int fd)
-{
-    if (fd == timer_pfd().fd)
-    {
-        return;
-    }
-    else if (fd == stop_pfd().fd)
-    {
-        for (auto& perf_writer : perf_writers_)
-        {
-            perf_writer.second->read();
-        }
-        return;
-    }
-    perf_writers_.at(fd)->read();
-}
-
 void TracepointMonitor::finalize_thread()
 {
-    perf_writers_.clear();
+    perf_writer_.reset();
 }
 } // namespace monitor
 } // namespace lo2s
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/monitor/uncore_monitor.hpp>
+
+#include <lo2s/config.hpp>
+#include <lo2s/log.hpp>
+#include <lo2s/perf/counter/counter_collection.hpp>
+#include <lo2s/topology.hpp>
+#include <lo2s/util.hpp>
+
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+namespace lo2s
+{
+namespace monitor
+{
+
+namespace
+{
+Topology::Cpu topology_cpu(uint32_t cpuid)
+{
+    for (const auto& cpu : Topology::instance().cpus())
+    {
+        if (cpu.id == cpuid)
+        {
+            return cpu;
+        }
+    }
+    throw std::runtime_error("cpu " + std::to_string(cpuid) +
+                             " in the cpumask of an uncore PMU is not online");
+}
+
+// Whether the PMU counts per package, i.e. its cpumask has exactly one CPU of every package
+bool per_package(const std::set<uint32_t>& cpumask)
+{
+    std::set<uint32_t> packages;
+    for (auto cpu : cpumask)
+    {
+        packages.insert(topology_cpu(cpu).package_id);
+    }
+    return packages.size() == cpumask.size() &&
+           packages.size() == Topology::instance().num_packages();
+}
+} // namespace
+
+UncoreMonitor::UncoreMonitor(trace::Trace& trace, int cpuid)
+: PollMonitor(trace, std::to_string(cpuid), config().read_interval), cpu_(cpuid)
+{
+    // Events of different PMUs can not be grouped together
+    std::map<std::string, std::vector<perf::EventDescription>> pmu_events;
+    for (const auto& counter : perf::counter::requested_counters().uncore_counters)
+    {
+        if (counter.cpus.count(cpuid))
+        {
+            pmu_events[counter.pmu].push_back(counter);
+        }
+    }
+
+    for (const auto& pmu : pmu_events)
+    {
+        // Not every PMU with a cpumask counts per package, e.g. cstate_core has one CPU per core
+        // in its cpumask. Those are recorded for the CPU in the cpumask that stands for the unit.
+        const auto& cpumask = pmu.second.front().cpus;
+        std::string name;
+        const otf2::definition::system_tree_node* scope;
+        if (per_package(cpumask))
+        {
+            auto package = topology_cpu(cpuid).package_id;
+            name = pmu.first + " (package " + std::to_string(package) + ")";
+            scope = &trace.system_tree_package_node(package);
+        }
+        else if (cpumask.size() == 1)
+        {
+            name = pmu.first;
+            scope = &trace.system_tree_root_node();
+        }
+        else
+        {
+            name = pmu.first + " (cpu " + std::to_string(cpuid) + ")";
+            scope = &trace.system_tree_cpu_node(cpuid);
+        }
+
+        Log::debug() << "Recording uncore PMU " << pmu.first << " on cpu #" << cpuid << " as "
+                     << name;
+
+        perf::counter::CounterCollection collection{
+            pmu.second.front(), { pmu.second.begin() + 1, pmu.second.end() }, {}, {}
+        };
+
+        auto& writer = trace.named_metric_writer(name);
+        writers_.emplace_back(std::make_unique<perf::counter::UncoreWriter>(
+            cpuid, collection, writer,
+            trace.metric_instance(trace.uncore_metric_class(pmu.first), writer.location(),
+                                  *scope)));
+    }
+}
+
+void UncoreMonitor::initialize_thread()
+{
+    try_pin_to_cpu(cpu_);
+}
+
+void UncoreMonitor::monitor()
+{
+    for (auto& writer : writers_)
+    {
+        writer->read();
+    }
+}
+
+void UncoreMonitor::finalize_thread()
+{
+    writers_.clear();
+}
+} // namespace monitor
+} // namespace lo2s
@@ -23,6 +23,8 @@
 #include <lo2s/perf/counter/abstract_writer.hpp>
 #include <lo2s/time/time.hpp>
 
+#include <algorithm>
+
 namespace lo2s
 {
 namespace perf
@@ -33,33 +35,30 @@ AbstractWriter::AbstractWriter(pid_t tid, int cpuid, otf2::writer::local& writer
                                otf2::definition::metric_instance metric_instance,
                                bool enable_on_exec)
 : Reader(tid, cpuid, requested_counters(), enable_on_exec),
-  time_converter_(time::Converter::instance()), writer_(writer), metric_instance_(metric_instance),
-  metric_event_(otf2::chrono::genesis(), metric_instance)
+  time_converter_(time::Converter::instance()), metric_writer_(writer, metric_instance)
 {
 }
 
 bool AbstractWriter::handle(const Reader::RecordSampleType* sample)
 {
-    // update event timestamp from sample
-    metric_event_.timestamp(time_converter_(sample->time));
-
-    counter_buffer_.read(&sample->v);
-
-    otf2::event::metric::values& values = metric_event_.raw_values();
-
-    assert(counter_buffer_.size() <= values.size());
-
-    // read counter values into metric event
-    for (std::size_t i = 0; i <= counter_buffer_.size(); i++)
+    auto group = std::find_if(groups_.begin(), groups_.end(),
+                              [sample](const auto& group) { return group.id == sample->id; });
+    if (group == groups_.end())
     {
-        values[i] = counter_buffer_[i];
+        Log::warn() << "counter::AbstractWriter: record for unknown counter group " << sample->id;
+        return false;
     }
 
-    auto index = counter_fds_.size();
-    values[index++] = counter_buffer_.enabled();
-    values[index++] = counter_buffer_.running();
+    group->buffer.read(&sample->v);
+
+    // Values of the other groups stay at their last readout. As all members are accumulated,
+    // repeating them is fine.
+    collect_counter_values(groups_, metric_writer_.values());
 
-    writer_.write(metric_event_);
+    // The groups are read out one after another with the same frequency. Evaluating the derived
+    // metrics only on the first group makes sure that the inputs from all groups span (roughly)
+    // the same interval.
+    metric_writer_.write(time_converter_(sample->time), group == groups_.begin());
     return false;
 }
 } // namespace counter
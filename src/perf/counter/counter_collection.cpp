@@ -36,6 +36,7 @@ CounterCollection collect_requested_counters()
     const auto& user_events = lo2s::config().perf_events;
 
     std::vector<perf::EventDescription> used_counters;
+    std::vector<perf::EventDescription> uncore_counters;
 
     used_counters.reserve(user_events.size());
     for (const auto& ev : user_events)
@@ -51,6 +52,20 @@ CounterCollection collect_requested_counters()
         try
         {
             const auto event_desc = perf::EventProvider::get_event_by_name(ev);
+            if (event_desc.uncore())
+            {
+                if (config().monitor_type == MonitorType::CPU_SET)
+                {
+                    uncore_counters.emplace_back(event_desc);
+                }
+                else
+                {
+                    Log::warn() << "'" << ev
+                                << "' is an uncore event, which can only be recorded in "
+                                   "system-monitoring mode (-a), ignoring!";
+                }
+                continue;
+            }
             used_counters.emplace_back(event_desc);
         }
         catch (const perf::EventProvider::InvalidEvent& e)
@@ -92,9 +107,15 @@ CounterCollection collect_requested_counters()
 
     if (used_counters.empty())
     {
+        if (!config().derived_metrics.empty())
+        {
+            Log::warn() << "Derived metrics require at least one metric event (-E), ignoring them.";
+        }
         // if no events will be recorded, we make an early exit with a fake leader
         return { EventDescription(std::string(), static_cast<perf_type_id>(-1), 0, 0),
-                 std::move(used_counters) };
+                 std::move(used_counters),
+                 {},
+                 std::move(uncore_counters) };
     }
     if (config().metric_leader.empty())
     {
@@ -110,8 +131,26 @@ CounterCollection collect_requested_counters()
         throw perf::EventProvider::InvalidEvent(lo2s::config().metric_leader);
     }
 
-    return { perf::EventProvider::get_event_by_name(config().metric_leader),
-             std::move(used_counters) };
+    auto leader = perf::EventProvider::get_event_by_name(config().metric_leader);
+
+    // Derived metrics refer to the values in the order they are read out
+    std::vector<std::string> variables;
+    variables.push_back(leader.name);
+    for (const auto& counter : used_counters)
+    {
+        variables.push_back(counter.name);
+    }
+    variables.push_back("time_enabled");
+    variables.push_back("time_running");
+
+    std::vector<DerivedMetric> derived_metrics;
+    for (const auto& definition : config().derived_metrics)
+    {
+        derived_metrics.emplace_back(definition, variables);
+    }
+
+    return { std::move(leader), std::move(used_counters), std::move(derived_metrics),
+             std::move(uncore_counters) };
 }
 
 const CounterCollection& requested_counters()
@@ -0,0 +1,95 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/counter/counting_reader.hpp>
+
+#include <lo2s/error.hpp>
+#include <lo2s/log.hpp>
+
+#include <algorithm>
+
+extern "C"
+{
+#include <unistd.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+CountingReader::CountingReader(pid_t tid, int cpuid, const CounterCollection& counter_collection,
+                               bool enable_on_exec)
+: groups_(open_counter_groups(tid, cpuid, counter_collection, enable_on_exec, 0))
+{
+    for (const auto& group : groups_)
+    {
+        read_buffer_size_ =
+            std::max(read_buffer_size_, GroupReadFormat::total_size(group.counter_fds.size() + 1));
+    }
+    read_buffer_ = std::make_unique<std::byte[]>(read_buffer_size_);
+
+    if (!enable_on_exec)
+    {
+        try
+        {
+            enable_counter_groups(groups_);
+        }
+        catch (...)
+        {
+            close_counter_groups(groups_);
+            throw;
+        }
+    }
+}
+
+CountingReader::~CountingReader()
+{
+    close_counter_groups(groups_);
+}
+
+void CountingReader::read(std::vector<double>& values)
+{
+    auto buf = reinterpret_cast<GroupReadFormat*>(read_buffer_.get());
+    for (auto& group : groups_)
+    {
+        auto size = GroupReadFormat::total_size(group.counter_fds.size() + 1);
+        auto ret = ::read(group.leader_fd, buf, size);
+        if (ret == 0)
+        {
+            // A pinned group that could not be scheduled is in error state and reads EOF
+            Log::debug() << "counter::CountingReader: counter group can not be read";
+            continue;
+        }
+        if (ret != static_cast<ssize_t>(size))
+        {
+            Log::error() << "reading perf counter group failed";
+            throw_errno();
+        }
+        group.buffer.read(buf);
+    }
+
+    collect_counter_values(groups_, values);
+}
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/counter/derived_metric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+// Recursive descent parser, which emits the bytecode while parsing:
+//
+//   expression := term { ('+' | '-') term }
+//   term       := unary { ('*' | '/') unary }
+//   unary      := '-' unary | primary
+//   primary    := number | identifier | '{' event-name '}' | '(' expression ')'
+class ExpressionParser
+{
+public:
+    ExpressionParser(DerivedMetric& metric, const std::string& definition,
+                     const std::vector<std::string>& variables)
+    : metric_(metric), definition_(definition), variables_(variables)
+    {
+    }
+
+    void parse()
+    {
+        const auto& input = metric_.expression_;
+        expression();
+        skip_whitespace();
+        if (pos_ != input.size())
+        {
+            fail("unexpected '" + input.substr(pos_, 1) + "' at position " + std::to_string(pos_));
+        }
+        assert(depth_ == 1);
+    }
+
+private:
+    using OpCode = DerivedMetric::OpCode;
+
+    static constexpr std::size_t max_nesting = 64;
+
+    void expression()
+    {
+        term();
+        while (true)
+        {
+            if (accept('+'))
+            {
+                term();
+                emit(OpCode::ADD);
+            }
+            else if (accept('-'))
+            {
+                term();
+                emit(OpCode::SUBTRACT);
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    void term()
+    {
+        unary();
+        while (true)
+        {
+            if (accept('*'))
+            {
+                unary();
+                emit(OpCode::MULTIPLY);
+            }
+            else if (accept('/'))
+            {
+                unary();
+                emit(OpCode::DIVIDE);
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    void unary()
+    {
+        if (accept('-'))
+        {
+            nest();
+            unary();
+            nesting_--;
+            emit(OpCode::NEGATE);
+        }
+        else
+        {
+            primary();
+        }
+    }
+
+    void primary()
+    {
+        const auto& input = metric_.expression_;
+        skip_whitespace();
+        if (pos_ == input.size())
+        {
+            fail("unexpected end of expression");
+        }
+
+        if (accept('('))
+        {
+            nest();
+            expression();
+            if (!accept(')'))
+            {
+                fail("missing ')'");
+            }
+            nesting_--;
+        }
+        else if (accept('{'))
+        {
+            auto end = input.find('}', pos_);
+            if (end == std::string::npos)
+            {
+                fail("missing '}'");
+            }
+            variable(input.substr(pos_, end - pos_));
+            pos_ = end + 1;
+        }
+        else if (std::isalpha(static_cast<unsigned char>(input[pos_])) || input[pos_] == '_')
+        {
+            auto start = pos_;
+            while (pos_ < input.size() &&
+                   (std::isalnum(static_cast<unsigned char>(input[pos_])) || input[pos_] == '_' ||
+                    input[pos_] == '.'))
+            {
+                pos_++;
+            }
+            variable(input.substr(start, pos_ - start));
+        }
+        else
+        {
+            const char* start = input.c_str() + pos_;
+            char* end;
+            double value = std::strtod(start, &end);
+            if (end == start)
+            {
+                fail("unexpected '" + input.substr(pos_, 1) + "' at position " +
+                     std::to_string(pos_));
+            }
+            pos_ += end - start;
+            emit(OpCode::CONSTANT, value);
+        }
+    }
+
+    void variable(const std::string& name)
+    {
+        auto it = std::find(variables_.begin(), variables_.end(), name);
+        if (it == variables_.end())
+        {
+            fail("'" + name + "' is not a recorded metric event");
+        }
+        emit(OpCode::VARIABLE, 0, it - variables_.begin());
+    }
+
+    bool accept(char c)
+    {
+        skip_whitespace();
+        if (pos_ < metric_.expression_.size() && metric_.expression_[pos_] == c)
+        {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void skip_whitespace()
+    {
+        while (pos_ < metric_.expression_.size() &&
+               std::isspace(static_cast<unsigned char>(metric_.expression_[pos_])))
+        {
+            pos_++;
+        }
+    }
+
+    // Bounds the recursion of the parser, parentheses and unary minus do not grow the stack
+    void nest()
+    {
+        if (++nesting_ > max_nesting)
+        {
+            fail("expression is nested too deeply");
+        }
+    }
+
+    void emit(OpCode op, double constant = 0, std::size_t variable = 0)
+    {
+        switch (op)
+        {
+        case OpCode::CONSTANT:
+        case OpCode::VARIABLE:
+            depth_++;
+            break;
+        case OpCode::NEGATE:
+            break;
+        default:
+            depth_--;
+        }
+        if (depth_ > DerivedMetric::max_stack_depth)
+        {
+            fail("expression is nested too deeply");
+        }
+        metric_.code_.push_back({ op, constant, variable });
+    }
+
+    [[noreturn]] void fail(const std::string& what)
+    {
+        throw DerivedMetric::InvalidExpression(definition_, what);
+    }
+
+    DerivedMetric& metric_;
+    const std::string& definition_;
+    const std::vector<std::string>& variables_;
+    std::size_t pos_ = 0;
+    std::size_t depth_ = 0;
+    std::size_t nesting_ = 0;
+};
+
+DerivedMetric::DerivedMetric(const std::string& definition,
+                             const std::vector<std::string>& variables)
+{
+    auto pos = definition.find('=');
+    if (pos == std::string::npos || pos == 0)
+    {
+        throw InvalidExpression(definition, "expected NAME=EXPRESSION");
+    }
+    name_ = definition.substr(0, pos);
+    expression_ = definition.substr(pos + 1);
+
+    ExpressionParser(*this, definition, variables).parse();
+}
+
+double DerivedMetric::evaluate(const std::vector<double>& values) const
+{
+    std::array<double, max_stack_depth> stack;
+    std::size_t top = 0;
+
+    for (const auto& instruction : code_)
+    {
+        switch (instruction.op)
+        {
+        case OpCode::CONSTANT:
+            stack[top++] = instruction.constant;
+            break;
+        case OpCode::VARIABLE:
+            stack[top++] = values[instruction.variable];
+            break;
+        case OpCode::NEGATE:
+            stack[top - 1] = -stack[top - 1];
+            break;
+        case OpCode::ADD:
+            top--;
+            stack[top - 1] += stack[top];
+            break;
+        case OpCode::SUBTRACT:
+            top--;
+            stack[top - 1] -= stack[top];
+            break;
+        case OpCode::MULTIPLY:
+            top--;
+            stack[top - 1] *= stack[top];
+            break;
+        case OpCode::DIVIDE:
+            top--;
+            stack[top - 1] = stack[top] == 0 ? 0 : stack[top - 1] / stack[top];
+            break;
+        }
+    }
+    return stack[0];
+}
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/counter/metric_writer.hpp>
+
+#include <lo2s/config.hpp>
+#include <lo2s/perf/counter/counter_collection.hpp>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+MetricWriter::MetricWriter(otf2::writer::local& writer,
+                           otf2::definition::metric_instance metric_instance)
+: writer_(writer), metric_instance_(metric_instance),
+  metric_event_(otf2::chrono::genesis(), metric_instance),
+  current_values_(requested_counters().counters.size() + 3, 0),
+  previous_values_(current_values_.size(), 0), deltas_(current_values_.size(), 0),
+  derived_values_(requested_counters().derived_metrics.size(), 0)
+{
+}
+
+void MetricWriter::write(otf2::chrono::time_point tp, bool update_derived)
+{
+    metric_event_.timestamp(tp);
+
+    otf2::event::metric::values& values = metric_event_.raw_values();
+    std::size_t index = 0;
+
+    if (!config().derived_metrics_only)
+    {
+        for (auto value : current_values_)
+        {
+            values[index++] = value;
+        }
+    }
+
+    if (!derived_values_.empty() && update_derived)
+    {
+        update_derived_metrics();
+    }
+    for (auto value : derived_values_)
+    {
+        values[index++] = value;
+    }
+
+    writer_.write(metric_event_);
+}
+
+void MetricWriter::update_derived_metrics()
+{
+    // Derived metrics are computed from the difference to the previous evaluation
+    for (std::size_t i = 0; i < current_values_.size(); i++)
+    {
+        deltas_[i] = current_values_[i] - previous_values_[i];
+    }
+    previous_values_ = current_values_;
+
+    const auto& derived_metrics = requested_counters().derived_metrics;
+    for (std::size_t i = 0; i < derived_metrics.size(); i++)
+    {
+        derived_values_[i] = derived_metrics[i].evaluate(deltas_);
+    }
+}
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
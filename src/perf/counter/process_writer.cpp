@@ -34,6 +34,7 @@ ProcessWriter::ProcessWriter(pid_t pid, pid_t tid, otf2::writer::local& writer,
                                      parent.trace().thread_sample_writer(pid, tid).location()),
       enable_on_exec)
 {
+    init_stats(parent.trace(), writer.location());
 }
 } // namespace counter
 } // namespace perf
@@ -46,14 +46,21 @@ namespace counter
 {
 
 int perf_try_event_open(struct perf_event_attr* perf_attr, pid_t tid, int cpu, int group_fd,
-                        unsigned long flags)
+                        unsigned long flags, bool uncore)
 {
     int fd = perf_event_open(perf_attr, tid, cpu, group_fd, flags);
-    if (fd < 0 && errno == EACCES && !perf_attr->exclude_kernel && perf_event_paranoid() > 1)
+    if (fd < 0)
     {
-        perf_attr->exclude_kernel = 1;
-        perf_warn_paranoid();
-        fd = perf_event_open(perf_attr, tid, cpu, group_fd, flags);
+        int error = errno;
+        if (exclude_kernel_fallback(*perf_attr, uncore, error, perf_event_paranoid()))
+        {
+            perf_warn_paranoid();
+            fd = perf_event_open(perf_attr, tid, cpu, group_fd, flags);
+        }
+        else
+        {
+            errno = error;
+        }
     }
     return fd;
 }
@@ -67,7 +74,7 @@ int open_counter(pid_t tid, int cpuid, const EventDescription& desc, int group_f
     perf_attr.type = desc.type;
     perf_attr.config = desc.config;
     perf_attr.config1 = desc.config1;
-    perf_attr.exclude_kernel = config().exclude_kernel;
+    perf_attr.exclude_kernel = config().exclude_kernel && !desc.uncore();
     // Needed when scaling multiplexed events, and recognize activation phases
     perf_attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
 
@@ -76,7 +83,7 @@ int open_counter(pid_t tid, int cpuid, const EventDescription& desc, int group_f
     perf_attr.clockid = config().clockid;
 #endif
 
-    int fd = perf_try_event_open(&perf_attr, tid, cpuid, group_fd, 0);
+    int fd = perf_try_event_open(&perf_attr, tid, cpuid, group_fd, 0, desc.uncore());
     if (fd < 0)
     {
         Log::error() << "perf_event_open for counter failed";
@@ -85,80 +92,257 @@ int open_counter(pid_t tid, int cpuid, const EventDescription& desc, int group_f
     return fd;
 }
 
-template <class T>
-Reader<T>::Reader(pid_t tid, int cpuid, const CounterCollection& counter_collection,
-                  bool enable_on_exec)
-: counter_buffer_(counter_collection.counters.size() + 1)
+int open_leader(pid_t tid, int cpuid, const EventDescription& leader, bool enable_on_exec,
+                std::size_t mmap_pages, bool pinned)
 {
     perf_event_attr leader_attr = common_perf_event_attrs();
 
-    leader_attr.type = counter_collection.leader.type;
-    leader_attr.config = counter_collection.leader.config;
-    leader_attr.config1 = counter_collection.leader.config1;
-
-    leader_attr.sample_type = PERF_SAMPLE_TIME | PERF_SAMPLE_READ;
-    leader_attr.freq = config().metric_use_frequency;
+    leader_attr.type = leader.type;
+    leader_attr.config = leader.config;
+    leader_attr.config1 = leader.config1;
 
-    if (leader_attr.freq)
+    if (mmap_pages != 0)
     {
-        Log::debug() << "counter::Reader: sample_freq: " << config().metric_frequency;
+        // The records of all groups end up in the same ring buffer, PERF_SAMPLE_IDENTIFIER tells
+        // them apart
+        leader_attr.sample_type = PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_TIME | PERF_SAMPLE_READ;
+        set_wakeup_watermark(leader_attr, mmap_pages);
+        leader_attr.freq = config().metric_use_frequency;
 
-        leader_attr.sample_freq = config().metric_frequency;
-    }
-    else
-    {
-        Log::debug() << "counter::Reader: sample_period: " << config().metric_count;
-        leader_attr.sample_period = config().metric_count;
+        if (leader_attr.freq)
+        {
+            Log::debug() << "counter::Reader: sample_freq: " << config().metric_frequency;
+
+            leader_attr.sample_freq = config().metric_frequency;
+        }
+        else
+        {
+            Log::debug() << "counter::Reader: sample_period: " << config().metric_count;
+            leader_attr.sample_period = config().metric_count;
+        }
     }
 
-    leader_attr.exclude_kernel = config().exclude_kernel;
+    leader_attr.exclude_kernel = config().exclude_kernel && !leader.uncore();
     leader_attr.read_format =
         PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING | PERF_FORMAT_GROUP;
     leader_attr.enable_on_exec = enable_on_exec;
+    leader_attr.pinned = pinned;
 
-    group_leader_fd_ = perf_try_event_open(&leader_attr, tid, cpuid, -1, 0);
-    if (group_leader_fd_ < 0)
+    int fd = perf_try_event_open(&leader_attr, tid, cpuid, -1, 0, leader.uncore());
+    if (fd < 0)
     {
         Log::error() << "perf_event_open for counter group leader failed";
         throw_errno();
     }
+    return fd;
+}
+
+std::vector<CounterGroup> open_counter_groups(pid_t tid, int cpuid,
+                                              const CounterCollection& counter_collection,
+                                              bool enable_on_exec, std::size_t mmap_pages)
+{
+    Log::debug() << "counter::Reader: leader event: '" << counter_collection.leader.name << "'";
+
+    // Partition the counters into groups first-fit. The kernel refuses to add an event to a group
+    // with EINVAL if the group can not be scheduled on the PMU as a whole anymore.
+    struct PendingGroup
+    {
+        int leader_fd;
+        std::vector<int> counter_fds;
+        std::vector<std::size_t> indices;
+    };
+    std::vector<PendingGroup> pending;
 
-    Log::debug() << "counter::Reader: leader event: '" << config().metric_leader << "'";
+    auto open_group = [&]() {
+        bool pinned =
+            pending.empty() && config().metric_group_rotation == CounterGroupRotation::PIN_FIRST;
+        pending.push_back({ open_leader(tid, cpuid, counter_collection.leader, enable_on_exec,
+                                        mmap_pages, pinned),
+                            {},
+                            {} });
+    };
 
-    counter_fds_.reserve(counter_collection.counters.size());
-    for (auto& description : counter_collection.counters)
+    try
     {
-        try
+        for (std::size_t index = 0; index < counter_collection.counters.size(); index++)
         {
-            counter_fds_.emplace_back(open_counter(tid, cpuid, description, group_leader_fd_));
+            const auto& description = counter_collection.counters[index];
+
+            bool added = false;
+            for (auto& group : pending)
+            {
+                try
+                {
+                    group.counter_fds.emplace_back(
+                        open_counter(tid, cpuid, description, group.leader_fd));
+                    group.indices.emplace_back(index);
+                    added = true;
+                    break;
+                }
+                catch (const std::system_error& e)
+                {
+                    if (e.code().value() != EINVAL)
+                    {
+                        Log::error() << "failed to add counter '" << description.name
+                                     << "': " << e.code().message();
+                        throw;
+                    }
+                }
+            }
+
+            if (added)
+            {
+                continue;
+            }
+
+            open_group();
+            try
+            {
+                pending.back().counter_fds.emplace_back(
+                    open_counter(tid, cpuid, description, pending.back().leader_fd));
+                pending.back().indices.emplace_back(index);
+            }
+            catch (const std::system_error& e)
+            {
+                Log::error() << "failed to add counter '" << description.name
+                             << "': " << e.code().message();
+                if (e.code().value() == EINVAL)
+                {
+                    Log::error() << "the counter can not be scheduled together with the metric "
+                                    "leader '"
+                                 << counter_collection.leader.name << "'";
+                }
+                throw;
+            }
         }
-        catch (const std::system_error& e)
+
+        if (pending.empty())
+        {
+            // Keep the leader even without any counters to record its own value
+            open_group();
+        }
+
+        if (pending.size() > 1)
         {
-            Log::error() << "failed to add counter '" << description.name
-                         << "': " << e.code().message();
+            Log::info() << "counter::Reader: split " << counter_collection.counters.size()
+                        << " counters into " << pending.size() << " groups";
+        }
+    }
+    catch (...)
+    {
+        for (auto& group : pending)
+        {
+            for (int fd : group.counter_fds)
+            {
+                ::close(fd);
+            }
+            ::close(group.leader_fd);
+        }
+        throw;
+    }
+
+    std::vector<CounterGroup> groups;
+    groups.reserve(pending.size());
+    for (auto& group : pending)
+    {
+        groups.emplace_back(group.leader_fd, group.counter_fds.size());
+        groups.back().counter_fds = std::move(group.counter_fds);
+        groups.back().indices = std::move(group.indices);
+    }
+    return groups;
+}
 
-            if (e.code().value() == EINVAL)
+void close_counter_groups(std::vector<CounterGroup>& groups)
+{
+    for (auto& group : groups)
+    {
+        for (int fd : group.counter_fds)
+        {
+            if (fd != -1)
             {
-                Log::error()
-                    << "opening " << counter_collection.counters.size()
-                    << " counters at once might exceed the hardware limit of simultaneously "
-                       "openable counters.";
+                ::close(fd);
             }
-            throw e;
         }
+        ::close(group.leader_fd);
     }
+    groups.clear();
+}
 
-    if (!enable_on_exec)
+void enable_counter_groups(const std::vector<CounterGroup>& groups)
+{
+    for (const auto& group : groups)
     {
-        auto ret = ::ioctl(group_leader_fd_, PERF_EVENT_IOC_ENABLE);
+        auto ret = ::ioctl(group.leader_fd, PERF_EVENT_IOC_ENABLE);
         if (ret == -1)
         {
             Log::error() << "failed to enable perf counter group";
-            ::close(group_leader_fd_);
             throw_errno();
         }
     }
-    EventReader<T>::init_mmap(group_leader_fd_);
+}
+
+void collect_counter_values(const std::vector<CounterGroup>& groups, std::vector<double>& values)
+{
+    std::size_t index = 0;
+    values[index++] = groups.front().buffer[0];
+    for (const auto& group : groups)
+    {
+        for (std::size_t i = 0; i < group.indices.size(); i++)
+        {
+            values[index + group.indices[i]] = group.buffer[1 + i];
+        }
+    }
+
+    // time_enabled and time_running must be monotonic, so always take them from the first group
+    index = values.size() - 2;
+    values[index++] = groups.front().buffer.enabled();
+    values[index++] = groups.front().buffer.running();
+}
+
+template <class T>
+Reader<T>::Reader(pid_t tid, int cpuid, const CounterCollection& counter_collection,
+                  bool enable_on_exec)
+: EventReader<T>(RingKind::COUNTER),
+  groups_(open_counter_groups(tid, cpuid, counter_collection, enable_on_exec,
+                              EventReader<T>::mmap_pages_))
+{
+    try
+    {
+        for (auto& group : groups_)
+        {
+            if (::ioctl(group.leader_fd, PERF_EVENT_IOC_ID, &group.id) == -1)
+            {
+                Log::error() << "failed to get the sample id of a perf counter group";
+                throw_errno();
+            }
+        }
+
+        EventReader<T>::init_mmap(groups_.front().leader_fd);
+        redirect_outputs();
+
+        if (!enable_on_exec)
+        {
+            enable_counter_groups(groups_);
+        }
+    }
+    catch (...)
+    {
+        close_counter_groups(groups_);
+        throw;
+    }
+}
+
+template <class T>
+void Reader<T>::redirect_outputs()
+{
+    for (auto it = groups_.begin() + 1; it != groups_.end(); ++it)
+    {
+        if (::ioctl(it->leader_fd, PERF_EVENT_IOC_SET_OUTPUT, groups_.front().leader_fd) == -1)
+        {
+            Log::error() << "failed to redirect perf counter group into the shared ring buffer";
+            throw_errno();
+        }
+    }
 }
 
 template class Reader<AbstractWriter>;
@@ -0,0 +1,234 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/counter/userspace_reader.hpp>
+
+#include <lo2s/error.hpp>
+#include <lo2s/log.hpp>
+#include <lo2s/perf/counter/reader.hpp>
+#include <lo2s/platform.hpp>
+#include <lo2s/util.hpp>
+
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+extern "C"
+{
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace counter
+{
+
+#if defined(__x86_64__)
+static inline std::uint64_t rdpmc(std::uint32_t counter)
+{
+    std::uint32_t low, high;
+    asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return static_cast<std::uint64_t>(high) << 32 | low;
+}
+#endif
+
+UserspaceReader::UserspaceReader(int cpuid, const CounterCollection& counter_collection)
+: cpuid_(cpuid)
+{
+    std::vector<const EventDescription*> descriptions;
+    descriptions.push_back(&counter_collection.leader);
+    for (const auto& counter : counter_collection.counters)
+    {
+        descriptions.push_back(&counter);
+    }
+
+    counters_.reserve(descriptions.size());
+    try
+    {
+        for (const auto* description : descriptions)
+        {
+            int fd;
+            try
+            {
+                fd = open_counter(-1, cpuid, *description, -1);
+            }
+            catch (const std::system_error& e)
+            {
+                Log::error() << "failed to add counter '" << description->name
+                             << "': " << e.code().message();
+                throw;
+            }
+
+            // Only the first page, which contains the self-monitoring information, is needed
+            void* page = ::mmap(nullptr, get_page_size(), PROT_READ, MAP_SHARED, fd, 0);
+            if (page == MAP_FAILED)
+            {
+                Log::error() << "mapping the perf page for userspace counter reads failed";
+                ::close(fd);
+                throw_errno();
+            }
+            counters_.emplace_back(fd, static_cast<struct perf_event_mmap_page*>(page));
+        }
+    }
+    catch (...)
+    {
+        for (auto& counter : counters_)
+        {
+            ::munmap(counter.page, get_page_size());
+            ::close(counter.fd);
+        }
+        throw;
+    }
+}
+
+UserspaceReader::~UserspaceReader()
+{
+    for (auto& counter : counters_)
+    {
+        ::munmap(counter.page, get_page_size());
+        ::close(counter.fd);
+    }
+}
+
+void UserspaceReader::read(std::vector<double>& values)
+{
+    // rdpmc only yields the counter values of the CPU it is executed on
+    bool on_cpu = sched_getcpu() == cpuid_;
+    if (!on_cpu && !warned_fallback_)
+    {
+        Log::warn() << "userspace counter reads for cpu " << cpuid_
+                    << " are not executed on that cpu, falling back to read()";
+        warned_fallback_ = true;
+    }
+
+    GroupReadFormat result;
+    std::size_t index = 0;
+    for (auto& counter : counters_)
+    {
+        if (!on_cpu || !read_rdpmc(counter.page, result))
+        {
+            read_syscall(counter.fd, result);
+        }
+        counter.buffer.read(&result);
+        values[index++] = counter.buffer[0];
+    }
+
+    // Every counter is scaled on its own, report the times of the leader
+    values[index++] = counters_.front().buffer.enabled();
+    values[index++] = counters_.front().buffer.running();
+}
+
+bool UserspaceReader::read_rdpmc(const struct perf_event_mmap_page* page, GroupReadFormat& result)
+{
+#if defined(__x86_64__)
+    // See the description of struct perf_event_mmap_page in linux/perf_event.h
+    std::uint32_t seq;
+    std::uint64_t count, enabled, running;
+    std::uint64_t cycles = 0, time_offset = 0;
+    std::uint32_t time_mult = 0;
+    std::uint16_t time_shift = 0;
+    bool user_time;
+
+    do
+    {
+        seq = page->lock;
+        rmb();
+
+        if (!page->cap_user_rdpmc)
+        {
+            return false;
+        }
+
+        enabled = page->time_enabled;
+        running = page->time_running;
+
+        user_time = page->cap_user_time && enabled != running;
+        if (user_time)
+        {
+            cycles = __rdtsc();
+            time_offset = page->time_offset;
+            time_mult = page->time_mult;
+            time_shift = page->time_shift;
+        }
+
+        auto index = page->index;
+        count = page->offset;
+        if (index)
+        {
+            auto width = page->pmc_width;
+            std::int64_t pmc = rdpmc(index - 1);
+            pmc <<= 64 - width;
+            pmc >>= 64 - width;
+            count += pmc;
+        }
+
+        rmb();
+    } while (page->lock != seq);
+
+    if (user_time)
+    {
+        // time_enabled/time_running are only updated on context switches, extrapolate them
+        std::uint64_t quot = cycles >> time_shift;
+        std::uint64_t rem = cycles & ((std::uint64_t(1) << time_shift) - 1);
+        std::uint64_t delta = time_offset + quot * time_mult + ((rem * time_mult) >> time_shift);
+        enabled += delta;
+        if (page->index)
+        {
+            running += delta;
+        }
+    }
+
+    result.nr = 1;
+    result.time_enabled = enabled;
+    result.time_running = running;
+    result.values[0] = count;
+    return true;
+#else
+    (void)page;
+    (void)result;
+    return false;
+#endif
+}
+
+void UserspaceReader::read_syscall(int fd, GroupReadFormat& result)
+{
+    // read_format is PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+    std::uint64_t buf[3];
+    if (::read(fd, buf, sizeof(buf)) != sizeof(buf))
+    {
+        Log::error() << "reading perf counter failed";
+        throw_errno();
+    }
+
+    result.nr = 1;
+    result.values[0] = buf[0];
+    result.time_enabled = buf[1];
+    result.time_running = buf[2];
+}
+} // namespace counter
+} // namespace perf
+} // namespace lo2s
@@ -25,6 +25,7 @@
 #include <lo2s/perf/event_description.hpp>
 #include <lo2s/perf/event_provider.hpp>
 #include <lo2s/perf/util.hpp>
+#include <lo2s/util.hpp>
 
 #include <filesystem>
 #include <fstream>
@@ -159,10 +160,10 @@ static bool event_is_openable(EventDescription& ev)
     attr.type = ev.type;
     attr.config = ev.config;
     attr.config1 = ev.config1;
-    attr.exclude_kernel = 1;
+    attr.exclude_kernel = !ev.uncore();
 
     int proc_fd = perf_event_open(&attr, 0, -1, -1, 0);
-    int sys_fd = perf_event_open(&attr, -1, 1, -1, 0);
+    int sys_fd = perf_event_open(&attr, -1, ev.uncore() ? *ev.cpus.begin() : 1, -1, 0);
     if (sys_fd == -1 && proc_fd == -1)
     {
         switch (errno)
@@ -459,6 +460,15 @@ const EventDescription sysfs_read_event(const std::string& ev_desc)
         throw EventProvider::InvalidEvent("unknown PMU '"s + pmu_name + "'");
     }
     EventDescription event(ev_desc, static_cast<perf_type_id>(type), 0, 0);
+    event.pmu = pmu_name;
+
+    // Uncore PMUs only accept events on the CPUs in their cpumask, one per unit
+    std::string cpumask;
+    std::ifstream cpumask_stream(pmu_path / "cpumask");
+    if (std::getline(cpumask_stream, cpumask) && !cpumask.empty())
+    {
+        event.cpus = parse_list(cpumask);
+    }
 
     // Parse event configuration from sysfs //
 
@@ -523,6 +533,20 @@ const EventDescription sysfs_read_event(const std::string& ev_desc)
         ev_cfg = kv_match.suffix();
     }
 
+    std::ifstream scale_stream(pmu_path / "events" / (event_name + ".scale"));
+    double scale;
+    if (scale_stream >> scale)
+    {
+        event.scale = scale;
+    }
+
+    std::ifstream unit_stream(pmu_path / "events" / (event_name + ".unit"));
+    std::string unit;
+    if (unit_stream >> unit)
+    {
+        event.unit = unit;
+    }
+
     Log::debug() << std::hex << std::showbase << "parsed event description: " << pmu_name << "/"
                  << event_name << "/type=" << event.type << ",config=" << event.config
                  << ",config1=" << event.config1 << std::dec << std::noshowbase << "/";
@@ -0,0 +1,61 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/reader_stats.hpp>
+
+#include <lo2s/time/time.hpp>
+#include <lo2s/trace/trace.hpp>
+
+namespace lo2s
+{
+namespace perf
+{
+
+ReadoutTotals& thread_readout_totals()
+{
+    static thread_local ReadoutTotals totals;
+    return totals;
+}
+
+ReaderStats::ReaderStats(trace::Trace& trace, const otf2::definition::location& location)
+: writer_(trace.named_metric_writer("reader statistics for " + location.name().str())),
+  metric_instance_(
+      trace.metric_instance(trace.reader_stats_metric_class(), writer_.location(), location)),
+  event_(otf2::chrono::genesis(), metric_instance_)
+{
+}
+
+void ReaderStats::write(std::uint64_t lost, std::uint64_t throttled, double fill,
+                        std::size_t size, std::chrono::nanoseconds duration)
+{
+    event_.timestamp(lo2s::time::now());
+
+    auto& values = event_.raw_values();
+    values[0] = lost;
+    values[1] = throttled;
+    values[2] = fill * 100;
+    values[3] = static_cast<std::uint64_t>(size);
+    values[4] = static_cast<std::uint64_t>(duration.count());
+
+    writer_ << event_;
+}
+} // namespace perf
+} // namespace lo2s
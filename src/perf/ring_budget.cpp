@@ -0,0 +1,219 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/ring_budget.hpp>
+
+#include <lo2s/build_config.hpp>
+#include <lo2s/config.hpp>
+#include <lo2s/log.hpp>
+#include <lo2s/perf/counter/counter_collection.hpp>
+#include <lo2s/perf/util.hpp>
+#include <lo2s/topology.hpp>
+#include <lo2s/util.hpp>
+
+#include <algorithm>
+
+extern "C"
+{
+#include <sys/resource.h>
+#include <unistd.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+
+static std::size_t floor_power_of_two(std::size_t value)
+{
+    std::size_t result = 1;
+    while (result * 2 <= value)
+    {
+        result *= 2;
+    }
+    return result;
+}
+
+static std::size_t lockable_pages()
+{
+    if (geteuid() == 0 || perf_event_paranoid() == -1)
+    {
+        return 0;
+    }
+
+    std::size_t pages = 0;
+    try
+    {
+        // The kernel grants this amount per online CPU to every user
+        pages = get_sysctl<std::size_t>("kernel", "perf_event_mlock_kb") * 1024 /
+                get_page_size() * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    catch (...)
+    {
+        Log::warn() << "Failed to access kernel.perf_event_mlock_kb, assuming 516 KiB.";
+        pages = 516 * 1024 / get_page_size() * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0)
+    {
+        if (limit.rlim_cur == RLIM_INFINITY)
+        {
+            return 0;
+        }
+        pages += limit.rlim_cur / get_page_size();
+    }
+    return pages;
+}
+
+RingBudget::RingBudget()
+{
+    auto index = [](RingKind kind) { return static_cast<std::size_t>(kind); };
+
+    if (config().mmap_pages != 0)
+    {
+        planned_.fill(config().mmap_pages);
+        return;
+    }
+
+    // Preferred sizes
+    planned_[index(RingKind::SAMPLE)] = config().enable_cct ? 64 : 32;
+    planned_[index(RingKind::COUNTER)] = 8;
+    planned_[index(RingKind::TRACEPOINT)] = 16;
+    planned_[index(RingKind::SWITCH)] = 16;
+    planned_[index(RingKind::TIME)] = 1;
+    planned_[index(RingKind::OFF_CPU)] = 16;
+
+    // The readers created at the start of the measurement, either per CPU or per thread
+    std::array<std::size_t, static_cast<std::size_t>(RingKind::SIZE)> readers{};
+    const std::size_t cpus = Topology::instance().cpus().size();
+    const auto& counters = counter::requested_counters().counters;
+    const bool counter_rings =
+        !counters.empty() && !config().metric_counting && !config().metric_use_rdpmc;
+
+    readers[index(RingKind::TIME)] = 1;
+    // The tracepoints of --wakeup-latency share the ring buffer of the -t tracepoints
+    if (!config().tracepoint_events.empty() || config().wakeup_latency)
+    {
+        readers[index(RingKind::TRACEPOINT)] = cpus;
+    }
+    if (config().monitor_type == MonitorType::CPU_SET)
+    {
+#ifdef USE_PERF_RECORD_SWITCH
+        readers[index(RingKind::SAMPLE)] = cpus;
+#else
+        readers[index(RingKind::SAMPLE)] = config().sampling ? cpus : 0;
+        readers[index(RingKind::SWITCH)] += cpus;
+#endif
+    }
+    else
+    {
+        readers[index(RingKind::SAMPLE)] = config().sampling ? cpus : 0;
+        readers[index(RingKind::OFF_CPU)] = config().off_cpu ? cpus : 0;
+        if (config().syscalls)
+        {
+            readers[index(RingKind::TRACEPOINT)] += cpus;
+        }
+    }
+    if (counter_rings)
+    {
+        readers[index(RingKind::COUNTER)] = cpus;
+    }
+
+    limit_ = lockable_pages();
+    if (limit_ == 0)
+    {
+        Log::debug() << "ring buffer budget: unlimited";
+        return;
+    }
+
+    std::size_t preferred = 0;
+    for (std::size_t i = 0; i < planned_.size(); i++)
+    {
+        preferred += readers[i] * (planned_[i] + 1);
+    }
+
+    if (preferred > limit_)
+    {
+        // Scale the data pages so that, together with the header pages, everything fits
+        std::size_t header_pages = 0;
+        std::size_t data_pages = 0;
+        for (std::size_t i = 0; i < planned_.size(); i++)
+        {
+            header_pages += readers[i];
+            data_pages += readers[i] * planned_[i];
+        }
+        double factor =
+            (limit_ > header_pages) ? static_cast<double>(limit_ - header_pages) / data_pages : 0;
+
+        for (auto& pages : planned_)
+        {
+            pages = floor_power_of_two(static_cast<std::size_t>(pages * factor));
+        }
+
+        Log::info() << "The preferred ring buffer sizes exceed the lockable memory of "
+                    << limit_ * get_page_size() / 1024
+                    << " KiB (kernel.perf_event_mlock_kb), using smaller buffers.";
+    }
+
+    Log::debug() << "ring buffer budget: " << limit_ << " pages, sample: "
+                 << planned_[index(RingKind::SAMPLE)]
+                 << ", counter: " << planned_[index(RingKind::COUNTER)]
+                 << ", tracepoint: " << planned_[index(RingKind::TRACEPOINT)]
+                 << ", switch: " << planned_[index(RingKind::SWITCH)];
+}
+
+std::size_t RingBudget::reserve(RingKind kind)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    auto pages = planned_[static_cast<std::size_t>(kind)];
+    if (limit_ != 0)
+    {
+        // Readers beyond the plan get what is left. If not even a single page is left, the mmap
+        // fails with a helpful error message.
+        while (pages > 1 && used_ + pages + 1 > limit_)
+        {
+            pages /= 2;
+        }
+    }
+    used_ += pages + 1;
+    return pages;
+}
+
+void RingBudget::release(std::size_t pages)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    used_ -= pages + 1;
+}
+
+bool RingBudget::resize(std::size_t old_pages, std::size_t new_pages)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (limit_ != 0 && new_pages > old_pages && used_ + new_pages - old_pages > limit_)
+    {
+        return false;
+    }
+    used_ = used_ + new_pages - old_pages;
+    return true;
+}
+} // namespace perf
+} // namespace lo2s
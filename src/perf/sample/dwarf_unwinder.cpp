@@ -0,0 +1,198 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/sample/dwarf_unwinder.hpp>
+
+#include <lo2s/log.hpp>
+
+#include <cstring>
+#include <iterator>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace sample
+{
+
+namespace
+{
+const Dwfl_Callbacks dwfl_callbacks = {
+    dwfl_linux_proc_find_elf,
+    dwfl_standard_find_debuginfo,
+    nullptr,
+    nullptr,
+};
+
+// Position of the registers in the sample, perf writes them ordered by their perf register number
+enum SampleRegister
+{
+    AX,
+    BX,
+    CX,
+    DX,
+    SI,
+    DI,
+    BP,
+    SP,
+    IP,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15
+};
+
+// x86_64 DWARF register numbers 0 to 16: rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8 - r15, rip
+constexpr SampleRegister dwarf_registers[] = { AX, DX,  CX,  BX,  SI,  DI,  BP,  SP, R8,
+                                               R9, R10, R11, R12, R13, R14, R15, IP };
+} // namespace
+
+DwarfUnwinder::~DwarfUnwinder()
+{
+    for (auto& entry : dwfls_)
+    {
+        if (entry.second != nullptr)
+        {
+            dwfl_end(entry.second);
+        }
+    }
+}
+
+void DwarfUnwinder::invalidate(pid_t pid)
+{
+    auto it = dwfls_.find(pid);
+    if (it != dwfls_.end())
+    {
+        if (it->second != nullptr)
+        {
+            dwfl_end(it->second);
+        }
+        dwfls_.erase(it);
+    }
+}
+
+Dwfl* DwarfUnwinder::dwfl(pid_t pid)
+{
+    auto it = dwfls_.find(pid);
+    if (it != dwfls_.end())
+    {
+        return it->second;
+    }
+
+    static const Dwfl_Thread_Callbacks thread_callbacks = {
+        next_thread, nullptr, memory_read, set_initial_registers, nullptr, nullptr,
+    };
+
+    Dwfl* dwfl = dwfl_begin(&dwfl_callbacks);
+    if (dwfl != nullptr &&
+        (dwfl_linux_proc_report(dwfl, pid) != 0 || dwfl_report_end(dwfl, nullptr, nullptr) != 0 ||
+         !dwfl_attach_state(dwfl, nullptr, pid, &thread_callbacks, this)))
+    {
+        Log::debug() << "Cannot unwind call stacks of process " << pid << ": " << dwfl_errmsg(-1);
+        dwfl_end(dwfl);
+        dwfl = nullptr;
+    }
+
+    dwfls_.emplace(pid, dwfl);
+    return dwfl;
+}
+
+void DwarfUnwinder::unwind(pid_t pid, pid_t tid, const uint64_t* regs, const char* stack,
+                           std::size_t stack_size, std::vector<uint64_t>& frames)
+{
+    frames.clear();
+
+    Dwfl* process = dwfl(pid);
+    if (process != nullptr)
+    {
+        tid_ = tid;
+        regs_ = regs;
+        stack_ = stack;
+        stack_size_ = stack_size;
+        frames_ = &frames;
+
+        // Failing somewhere up the stack is normal, e.g. in functions without CFI, so keep the
+        // frames up to there
+        dwfl_getthread_frames(process, tid, frame, this);
+    }
+
+    if (frames.empty())
+    {
+        frames.push_back(regs[IP]);
+    }
+}
+
+pid_t DwarfUnwinder::next_thread(Dwfl*, void* arg, void** thread_arg)
+{
+    // Pretend the process has exactly the thread of the sample
+    if (*thread_arg != nullptr)
+    {
+        return 0;
+    }
+    *thread_arg = arg;
+    return static_cast<DwarfUnwinder*>(arg)->tid_;
+}
+
+bool DwarfUnwinder::memory_read(Dwfl*, Dwarf_Addr addr, Dwarf_Word* result, void* arg)
+{
+    // Only the copy of the stack is available, it starts at the stack pointer
+    auto* self = static_cast<DwarfUnwinder*>(arg);
+    Dwarf_Addr sp = self->regs_[SP];
+    if (addr < sp || addr + sizeof(Dwarf_Word) > sp + self->stack_size_)
+    {
+        return false;
+    }
+    std::memcpy(result, self->stack_ + (addr - sp), sizeof(Dwarf_Word));
+    return true;
+}
+
+bool DwarfUnwinder::set_initial_registers(Dwfl_Thread* thread, void* arg)
+{
+    auto* self = static_cast<DwarfUnwinder*>(arg);
+
+    Dwarf_Word registers[std::size(dwarf_registers)];
+    for (std::size_t i = 0; i < std::size(dwarf_registers); i++)
+    {
+        registers[i] = self->regs_[dwarf_registers[i]];
+    }
+    return dwfl_thread_state_registers(thread, 0, std::size(dwarf_registers), registers);
+}
+
+int DwarfUnwinder::frame(Dwfl_Frame* state, void* arg)
+{
+    auto* self = static_cast<DwarfUnwinder*>(arg);
+
+    Dwarf_Addr pc;
+    if (!dwfl_frame_pc(state, &pc, nullptr))
+    {
+        return DWARF_CB_ABORT;
+    }
+    self->frames_->push_back(pc);
+
+    return self->frames_->size() < max_frames ? DWARF_CB_OK : DWARF_CB_ABORT;
+}
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
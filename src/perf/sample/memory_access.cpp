@@ -0,0 +1,155 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/sample/memory_access.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace sample
+{
+
+MemoryLevel memory_level(std::uint64_t data_src)
+{
+    perf_mem_data_src src;
+    src.val = data_src;
+
+    if (!(src.mem_lvl & PERF_MEM_LVL_HIT))
+    {
+        return MemoryLevel::UNKNOWN;
+    }
+
+    // Check the closest level first, some CPUs report more than one
+    if (src.mem_lvl & PERF_MEM_LVL_L1)
+    {
+        return MemoryLevel::L1;
+    }
+    if (src.mem_lvl & PERF_MEM_LVL_LFB)
+    {
+        return MemoryLevel::LFB;
+    }
+    if (src.mem_lvl & PERF_MEM_LVL_L2)
+    {
+        return MemoryLevel::L2;
+    }
+    if (src.mem_lvl & PERF_MEM_LVL_L3)
+    {
+        return MemoryLevel::L3;
+    }
+    if (src.mem_lvl & PERF_MEM_LVL_LOC_RAM)
+    {
+        return MemoryLevel::LOCAL_RAM;
+    }
+    if (src.mem_lvl & (PERF_MEM_LVL_REM_CCE1 | PERF_MEM_LVL_REM_CCE2))
+    {
+        return MemoryLevel::REMOTE_CACHE;
+    }
+    if (src.mem_lvl & (PERF_MEM_LVL_REM_RAM1 | PERF_MEM_LVL_REM_RAM2))
+    {
+        return MemoryLevel::REMOTE_RAM;
+    }
+    if (src.mem_lvl & (PERF_MEM_LVL_IO | PERF_MEM_LVL_UNC))
+    {
+        return MemoryLevel::OTHER;
+    }
+    return MemoryLevel::UNKNOWN;
+}
+
+DataRegion DataRegions::classify(pid_t pid, std::uint64_t addr)
+{
+    static constexpr std::chrono::seconds reread_interval(1);
+
+    auto lookup = [addr](const Process& process) {
+        auto it = process.mappings.upper_bound(addr);
+        if (it == process.mappings.begin())
+        {
+            return DataRegion::UNKNOWN;
+        }
+        --it;
+        return addr < it->second.end ? it->second.region : DataRegion::UNKNOWN;
+    };
+
+    auto& process = processes_[pid];
+    auto region = lookup(process);
+    if (region == DataRegion::UNKNOWN)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (process.last_read == std::chrono::steady_clock::time_point() ||
+            now - process.last_read > reread_interval)
+        {
+            read_maps(pid, process);
+            process.last_read = now;
+            region = lookup(process);
+        }
+    }
+    return region;
+}
+
+void DataRegions::read_maps(pid_t pid, Process& process)
+{
+    // Lines look like: 7f0e1c000000-7f0e1c021000 rw-p 00000000 00:00 0    [heap]
+    process.mappings.clear();
+
+    std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        std::istringstream fields(line);
+        std::uint64_t start, end, offset, inode;
+        std::string perms, device, path;
+        char dash;
+        fields >> std::hex >> start >> dash >> end >> perms >> offset >> device >> std::dec >>
+            inode;
+        if (!fields)
+        {
+            continue;
+        }
+        std::getline(fields >> std::ws, path);
+
+        DataRegion region = DataRegion::ANONYMOUS;
+        if (path == "[heap]")
+        {
+            region = DataRegion::HEAP;
+        }
+        else if (path.rfind("[stack", 0) == 0)
+        {
+            region = DataRegion::STACK;
+        }
+        else if (inode != 0)
+        {
+            region = DataRegion::FILE;
+        }
+        process.mappings.emplace(start, Mapping{ end, region });
+    }
+}
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
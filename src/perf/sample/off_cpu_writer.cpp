@@ -0,0 +1,223 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/sample/off_cpu_writer.hpp>
+
+#include <lo2s/address.hpp>
+#include <lo2s/config.hpp>
+#include <lo2s/error.hpp>
+#include <lo2s/log.hpp>
+#include <lo2s/monitor/main_monitor.hpp>
+#include <lo2s/perf/util.hpp>
+#include <lo2s/time/time.hpp>
+
+#include <otf2xx/otf2.hpp>
+
+#include <algorithm>
+
+extern "C"
+{
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+
+#include <sys/ioctl.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace sample
+{
+
+OffCpuWriter::OffCpuWriter(pid_t pid, pid_t tid, monitor::MainMonitor& monitor,
+                           trace::Trace& trace, bool enable_on_exec)
+: EventReader(RingKind::OFF_CPU), pid_(pid), tid_(tid), monitor_(monitor), trace_(trace),
+  otf2_writer_(trace.thread_off_cpu_writer(pid, tid)),
+  time_converter_(perf::time::Converter::instance())
+{
+    struct perf_event_attr perf_attr = common_perf_event_attrs();
+    set_wakeup_watermark(perf_attr, mmap_pages_);
+
+    perf_attr.type = PERF_TYPE_SOFTWARE;
+    perf_attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    perf_attr.sample_period = 1;
+    perf_attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU |
+                            PERF_SAMPLE_CALLCHAIN;
+    perf_attr.sample_id_all = 1;
+    // The switch-in records end the off-CPU intervals
+    perf_attr.context_switch = 1;
+
+    // The event fires in the scheduler, so it must not exclude the kernel. --no-kernel only drops
+    // the kernel part of the stacks.
+    perf_attr.exclude_kernel = 0;
+    perf_attr.exclude_callchain_kernel = config().exclude_kernel;
+
+    if (enable_on_exec)
+    {
+        perf_attr.enable_on_exec = 1;
+    }
+
+    fd_ = perf_event_open(&perf_attr, tid, -1, -1, 0);
+    if (fd_ < 0)
+    {
+        Log::error() << "perf_event_open for off-CPU stacks of thread " << tid << " failed";
+        if (errno == EACCES && perf_event_paranoid() > 1)
+        {
+            Log::error() << "--off-cpu requires kernel.perf_event_paranoid <= 1";
+        }
+        throw_errno();
+    }
+
+    try
+    {
+        if (fcntl(fd_, F_SETFL, O_NONBLOCK))
+        {
+            throw_errno();
+        }
+
+        init_mmap(fd_);
+
+        if (!enable_on_exec && ioctl(fd_, PERF_EVENT_IOC_ENABLE) == -1)
+        {
+            throw_errno();
+        }
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+
+    init_stats(trace, otf2_writer_.location());
+}
+
+OffCpuWriter::~OffCpuWriter()
+{
+    close();
+
+    if (next_cctx_ref_ > 0)
+    {
+        const auto& mapping = trace_.merge_calling_contexts(local_cctx_refs_, next_cctx_ref_,
+                                                            monitor_.get_process_infos());
+        otf2_writer_ << mapping;
+    }
+}
+
+void OffCpuWriter::close()
+{
+    if (fd_ != -1)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+otf2::definition::calling_context::reference_type
+OffCpuWriter::cctx_ref(const RecordSampleType* sample, std::size_t& depth)
+{
+    auto thread = local_cctx_refs_.emplace(std::piecewise_construct,
+                                           std::forward_as_tuple(sample->tid),
+                                           std::forward_as_tuple(pid_, next_cctx_ref_));
+    if (thread.second)
+    {
+        next_cctx_ref_++;
+    }
+
+    auto ref = thread.first->second.entry.ref;
+    auto children = &thread.first->second.entry.children;
+    depth = 1;
+    // The call chain is innermost first, with PERF_CONTEXT_KERNEL and PERF_CONTEXT_USER markers in
+    // front of the kernel and the user part
+    for (auto i = sample->nr; i-- > 0;)
+    {
+        Address addr = sample->ips[i];
+        if (sample->ips[i] >= PERF_CONTEXT_MAX)
+        {
+            continue;
+        }
+
+        auto it = children->emplace(std::piecewise_construct, std::forward_as_tuple(addr),
+                                    std::forward_as_tuple(next_cctx_ref_));
+        if (it.second)
+        {
+            next_cctx_ref_++;
+        }
+        ref = it.first->second.ref;
+        children = &it.first->second.children;
+        depth++;
+    }
+    return ref;
+}
+
+bool OffCpuWriter::handle(const RecordSampleType* sample)
+{
+    auto tp = adjust_timepoints(time_converter_(sample->time));
+
+    // The switch-in record of the previous interval got lost
+    leave(tp);
+
+    std::size_t depth;
+    current_cctx_ = cctx_ref(sample, depth);
+    // Enter the whole stack at once, there is nothing below it on this location
+    otf2_writer_.write_calling_context_enter(tp, current_cctx_, depth);
+    return false;
+}
+
+bool OffCpuWriter::handle(const RecordSwitchType* context_switch)
+{
+    if (!(context_switch->header.misc & PERF_RECORD_MISC_SWITCH_OUT))
+    {
+        leave(adjust_timepoints(time_converter_(context_switch->time)));
+    }
+    return false;
+}
+
+void OffCpuWriter::leave(otf2::chrono::time_point tp)
+{
+    if (!current_cctx_.is_undefined())
+    {
+        otf2_writer_.write_calling_context_leave(tp, current_cctx_);
+        current_cctx_ = otf2::definition::calling_context::reference_type::undefined();
+    }
+}
+
+otf2::chrono::time_point OffCpuWriter::adjust_timepoints(otf2::chrono::time_point tp)
+{
+    if (last_time_point_ > tp)
+    {
+        Log::debug() << "off-CPU timestamps not in order: " << last_time_point_ << ">" << tp;
+        tp = last_time_point_;
+    }
+    last_time_point_ = tp;
+    return tp;
+}
+
+void OffCpuWriter::end()
+{
+    // A thread that exits is switched out for good
+    leave(adjust_timepoints(lo2s::time::now()));
+}
+} // namespace sample
+} // namespace perf
+} // namespace lo2s
@@ -37,12 +37,15 @@
 
 #include <otf2xx/otf2.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 
 extern "C"
 {
 #include <linux/perf_event.h>
+#include <sys/ioctl.h>
 }
 
 namespace lo2s
@@ -59,15 +62,68 @@ Writer::Writer(pid_t pid, pid_t tid, int cpu, monitor::MainMonitor& Monitor, tra
   cpuid_metric_instance_(trace.metric_instance(trace.cpuid_metric_class(), otf2_writer.location(),
                                                otf2_writer.location())),
   cpuid_metric_event_(otf2::chrono::genesis(), cpuid_metric_instance_),
-  time_converter_(perf::time::Converter::instance()), first_time_point_(lo2s::time::now()),
-  last_time_point_(first_time_point_)
+  time_converter_(perf::time::Converter::instance()),
+  reorder_buffer_(config().reorder_window, config().reorder_capacity),
+  adapt_period_(config().sampling && config().adaptive_period),
+  period_(config().sampling_period),
+  first_time_point_(lo2s::time::now()), last_time_point_(first_time_point_)
 {
     // Must monitor either a CPU or (exclusive) a tid/pid
     assert((cpu == -1) ^ (pid == -1 && tid == -1));
+
+    init_stats(trace, otf2_writer.location());
+
+#ifdef HAVE_LIBDW
+    if (has_cct_ && config().call_graph_mode == CallGraphMode::DWARF)
+    {
+        unwinder_.emplace();
+    }
+#endif
+
+    if (config().sampling && !config().sampling_group_events.empty())
+    {
+        group_buffer_.emplace(config().sampling_group_events.size() + 1);
+        previous_group_values_.assign(group_buffer_->size(), 0);
+        group_event_.emplace(otf2::chrono::genesis(),
+                             trace.metric_instance(trace.sample_group_metric_class(), location(),
+                                                   location()));
+    }
+
+    if (config().sampling && config().memory_sampling)
+    {
+        memory_event_.emplace(otf2::chrono::genesis(),
+                              trace.metric_instance(trace.memory_access_metric_class(), location(),
+                                                    location()));
+    }
+
+    if (has_period())
+    {
+        sample_period_event_.emplace(otf2::chrono::genesis(),
+                                     trace.metric_instance(trace.sampling_period_metric_class(),
+                                                           location(), location()));
+    }
 }
 
 Writer::~Writer()
 {
+    reorder_buffer_.flush([this](const perf_event_header* record) { release(record); });
+#ifdef HAVE_LIBDW
+    if (unwinder_)
+    {
+        write_deferred();
+    }
+#endif
+
+    if (reorder_buffer_.overflows() > 0 || reorder_buffer_.late() > 0)
+    {
+        Log::warn() << "Reorder window of sample writer for "
+                    << (cpuid_ == -1 ? "thread " : "cpu ") << (cpuid_ == -1 ? tid_ : cpuid_)
+                    << " overflowed " << reorder_buffer_.overflows() << " times and received "
+                    << reorder_buffer_.late()
+                    << " records too late to be ordered. Consider increasing "
+                       "--reorder-capacity or --reorder-window.";
+    }
+
     if (current_thread_cctx_refs_)
     {
         otf2_writer_.write_calling_context_leave(adjust_timepoints(lo2s::time::now()),
@@ -105,24 +161,98 @@ Writer::cctx_ref(const Reader::RecordSampleType* sample)
         auto it = find_ip_child(sample->ip, current_thread_cctx_refs_->second.entry.children);
         return it->second.ref;
     }
-    else
+#ifdef HAVE_LIBDW
+    else if (unwinder_)
     {
-        auto children = &current_thread_cctx_refs_->second.entry.children;
-        for (uint64_t i = sample->nr - 1;; i--)
+        const auto* regs = user_regs(sample);
+        if (regs->abi == PERF_SAMPLE_REGS_ABI_NONE)
         {
-            auto it = find_ip_child(sample->ips[i], *children);
-            // We intentionally discard the last sample as it is somewhere in the kernel
-            if (i == 1)
-            {
-                return it->second.ref;
-            }
-
-            children = &it->second.children;
+            frames_.assign(1, sample->ip);
         }
+        else
+        {
+            const auto* stack = user_stack(sample);
+            unwinder_->unwind(sample->pid, sample->tid, regs->regs, stack->data, stack->size,
+                              frames_);
+        }
+        return cctx_ref(frames_.data(), frames_.size());
+    }
+#endif
+    else if (lbr_call_stacks())
+    {
+        const auto* stack = branch_stack(sample);
+        lbr_call_stack(sample->ip, stack->entries, stack->nr, frames_);
+        return cctx_ref(frames_.data(), frames_.size());
+    }
+    else
+    {
+        // We intentionally discard the last sample as it is somewhere in the kernel
+        const auto* chain = callchain(sample);
+        return cctx_ref(chain->ips + 1, chain->nr - 1);
+    }
+}
+
+otf2::definition::calling_context::reference_type Writer::cctx_ref(const uint64_t* ips,
+                                                                   std::size_t nr)
+{
+    auto ref = current_thread_cctx_refs_->second.entry.ref;
+    auto children = &current_thread_cctx_refs_->second.entry.children;
+    for (std::size_t i = nr; i-- > 0;)
+    {
+        auto it = find_ip_child(ips[i], *children);
+        ref = it->second.ref;
+        children = &it->second.children;
+    }
+    return ref;
+}
+
+void Writer::release(const perf_event_header* record)
+{
+#ifdef HAVE_LIBDW
+    if (unwinder_)
+    {
+        defer(record);
+        return;
+    }
+#endif
+    write(record);
+}
+
+void Writer::write(const perf_event_header* record)
+{
+    switch (record->type)
+    {
+    case PERF_RECORD_SAMPLE:
+        write_sample(reinterpret_cast<const Reader::RecordSampleType*>(record));
+        break;
+#ifdef USE_PERF_RECORD_SWITCH
+    case PERF_RECORD_SWITCH_CPU_WIDE:
+        write_switch(reinterpret_cast<const Reader::RecordSwitchCpuWideType*>(record));
+        break;
+    case PERF_RECORD_SWITCH:
+        write_switch(reinterpret_cast<const Reader::RecordSwitchType*>(record));
+        break;
+#endif
+    default:
+        assert(false);
     }
 }
 
 bool Writer::handle(const Reader::RecordSampleType* sample)
+{
+    if (reorder_buffer_.enabled())
+    {
+        reorder_buffer_.push(sample->time, &sample->header,
+                             [this](const perf_event_header* record) { release(record); });
+    }
+    else
+    {
+        release(&sample->header);
+    }
+    return false;
+}
+
+void Writer::write_sample(const Reader::RecordSampleType* sample)
 {
     auto tp = time_converter_(sample->time);
     tp = adjust_timepoints(tp);
@@ -130,9 +260,43 @@ bool Writer::handle(const Reader::RecordSampleType* sample)
     update_current_thread(sample->pid, sample->tid, tp);
 
     cpuid_metric_event_.timestamp(tp);
-    cpuid_metric_event_.raw_values()[0] = sample->cpu;
+    cpuid_metric_event_.raw_values()[0] = cpu(sample);
     otf2_writer_ << cpuid_metric_event_;
 
+    if (group_event_)
+    {
+        // The events of the group since the previous sample are attributed to this sample
+        group_buffer_->read(group_values(sample));
+        auto& values = group_event_->raw_values();
+        for (std::size_t i = 0; i < group_buffer_->size(); i++)
+        {
+            values[i] = (*group_buffer_)[i] - previous_group_values_[i];
+            previous_group_values_[i] = (*group_buffer_)[i];
+        }
+        group_event_->timestamp(tp);
+        otf2_writer_ << *group_event_;
+    }
+
+    if (memory_event_)
+    {
+        const auto* access = memory_access(sample);
+        auto& values = memory_event_->raw_values();
+        values[0] = addr(sample);
+        values[1] = access->weight;
+        values[2] = static_cast<uint64_t>(memory_level(access->data_src));
+        values[3] = static_cast<uint64_t>(data_regions_.classify(sample->pid, addr(sample)));
+        memory_event_->timestamp(tp);
+        otf2_writer_ << *memory_event_;
+    }
+
+    if (sample_period_event_ && period(sample) != last_sample_period_)
+    {
+        last_sample_period_ = period(sample);
+        sample_period_event_->timestamp(tp);
+        sample_period_event_->raw_values()[0] = last_sample_period_;
+        otf2_writer_ << *sample_period_event_;
+    }
+
     // For unwind distance definiton, see:
     // http://scorepci.pages.jsc.fz-juelich.de/otf2-pipelines/docs/otf2-2.2/html/group__records__definition.html#CallingContext
 
@@ -149,15 +313,142 @@ bool Writer::handle(const Reader::RecordSampleType* sample)
     // the kernel, which can't be resolved and thus doesn't provide any useful information.
     //
     // Having these things in mind, look at this line and tell me, why it is still wrong:
-    auto unwind_distance = has_cct_ ? sample->nr /* + 1 - 1 */ : 2;
+    auto ref = cctx_ref(sample);
+    uint64_t unwind_distance = 2;
+    if (has_cct_)
+    {
+        // Stacks unwound from the user stack or taken from the LBR have no kernel entry to remove
+        unwind_distance =
+            stack_in_frames() ? frames_.size() + 1 : callchain(sample)->nr /* + 1 - 1 */;
+    }
 
     // we write the ugly raw ref-only events here due to performance reasons
-    otf2_writer_.write_calling_context_sample(tp, cctx_ref(sample), unwind_distance,
+    otf2_writer_.write_calling_context_sample(tp, ref, unwind_distance,
                                               trace_.interrupt_generator().ref());
+}
 
-    return false;
+#ifdef HAVE_LIBDW
+void Writer::defer(const perf_event_header* record)
+{
+    if (deferred_count_ == deferred_.size())
+    {
+        deferred_.emplace_back();
+    }
+    auto& copy = deferred_[deferred_count_++];
+
+    if (record->type != PERF_RECORD_SAMPLE)
+    {
+        copy.resize(record->size);
+        std::memcpy(copy.data(), record, record->size);
+        return;
+    }
+
+    // Only keep the part of the stack that was in use, but everything before and after the stack
+    const auto* begin = reinterpret_cast<const char*>(record);
+    const auto* stack = user_stack(reinterpret_cast<const RecordSampleType*>(record));
+    uint64_t stack_used = 0;
+    const char* tail = stack->data;
+    if (stack->size != 0)
+    {
+        std::memcpy(&stack_used, stack->data + stack->size, sizeof(stack_used));
+        stack_used = std::min(stack_used, stack->size);
+        tail = stack->data + stack->size + sizeof(stack_used);
+    }
+    std::size_t head_size = (stack->data - begin) + stack_used;
+    std::size_t tail_size = (begin + record->size) - tail;
+
+    copy.resize(head_size + tail_size);
+    std::memcpy(copy.data(), begin, head_size);
+    std::memcpy(copy.data() + head_size, tail, tail_size);
+
+    auto* sample = reinterpret_cast<RecordSampleType*>(copy.data());
+    sample->header.size = copy.size();
+    const_cast<UserStack*>(user_stack(sample))->size = stack_used;
+}
+
+void Writer::write_deferred()
+{
+    for (std::size_t i = 0; i < deferred_count_; i++)
+    {
+        write(reinterpret_cast<const perf_event_header*>(deferred_[i].data()));
+    }
+    deferred_count_ = 0;
+}
+#endif
+
+void Writer::records_handled()
+{
+    reorder_buffer_.copy_pending();
+}
+
+void Writer::readout_done(double fill, std::chrono::nanoseconds duration)
+{
+    static constexpr std::uint64_t max_period_factor = 1024;
+    static constexpr double overload_fill = 0.9;
+    static constexpr double relaxed_fill = 0.25;
+    static constexpr std::size_t relaxed_readouts_before_lowering = 50;
+
+#ifdef HAVE_LIBDW
+    if (unwinder_)
+    {
+        write_deferred();
+    }
+#endif
+
+    if (!adapt_period_)
+    {
+        return;
+    }
+
+    bool lost = static_cast<std::uint64_t>(lost_samples) != lost_at_last_readout_;
+    bool throttled = static_cast<std::uint64_t>(throttle_samples) != throttled_at_last_readout_;
+    lost_at_last_readout_ = lost_samples;
+    throttled_at_last_readout_ = throttle_samples;
+
+    // Taking more than half of the readout interval means the next readout is already due
+    bool slow =
+        config().perf_read_interval.count() != 0 && duration * 2 > config().perf_read_interval;
+
+    if (lost || throttled || slow || fill >= overload_fill)
+    {
+        relaxed_readouts_ = 0;
+        if (period_ < config().sampling_period * max_period_factor)
+        {
+            Log::debug() << "sample writer for " << location().name().str()
+                         << " is overloaded, raising sampling period to " << period_ * 2;
+            set_period(period_ * 2);
+        }
+    }
+    else if (fill < relaxed_fill && period_ > config().sampling_period)
+    {
+        if (++relaxed_readouts_ >= relaxed_readouts_before_lowering)
+        {
+            relaxed_readouts_ = 0;
+            set_period(std::max(config().sampling_period, period_ / 2));
+        }
+    }
+    else
+    {
+        relaxed_readouts_ = 0;
+    }
+}
+
+void Writer::set_period(std::uint64_t period)
+{
+    if (period != period_ && ioctl(fd(), PERF_EVENT_IOC_PERIOD, &period) == -1)
+    {
+        Log::warn() << "Changing the sampling period failed, disabling --adaptive-period: "
+                    << std::strerror(errno);
+        adapt_period_ = false;
+        return;
+    }
+    // The new period is written with the first sample taken with it
+    period_ = period;
 }
 
+// mmap and comm records are not sorted into the reorder window: Nothing they change is tied to
+// the time of a sample. The mappings are only resolved once the measurement ended, the unwinder
+// reads the current mappings from /proc on its next use and the thread names are written once.
 bool Writer::handle(const Reader::RecordMmapType* mmap_event)
 {
     // Since this is an mmap record (as opposed to mmap2), it will only be generated for executable
@@ -171,6 +462,12 @@ bool Writer::handle(const Reader::RecordMmapType* mmap_event)
                  << " pgoff: " << Address(mmap_event->pgoff) << ", " << mmap_event->filename;
 
     cached_mmap_events_.emplace_back(mmap_event);
+#ifdef HAVE_LIBDW
+    if (unwinder_)
+    {
+        unwinder_->invalidate(mmap_event->pid);
+    }
+#endif
     return false;
 }
 
@@ -222,7 +519,8 @@ void Writer::leave_current_thread(pid_t tid, otf2::chrono::time_point tp)
 
 otf2::chrono::time_point Writer::adjust_timepoints(otf2::chrono::time_point tp)
 {
-    // as the perf timepoints can not be trusted to be in order all the time fix them here
+    // Records are sorted by the reorder window, but anything that arrives later than the window
+    // (or with the window disabled) must still not break the monotonicity of the location
     if (last_time_point_ > tp)
     {
         Log::debug() << "perf_event_open timestamps not in order: " << last_time_point_ << ">"
@@ -235,6 +533,34 @@ otf2::chrono::time_point Writer::adjust_timepoints(otf2::chrono::time_point tp)
 
 #ifdef USE_PERF_RECORD_SWITCH
 bool Writer::handle(const Reader::RecordSwitchCpuWideType* context_switch)
+{
+    if (reorder_buffer_.enabled())
+    {
+        reorder_buffer_.push(context_switch->time, &context_switch->header,
+                             [this](const perf_event_header* record) { release(record); });
+    }
+    else
+    {
+        release(&context_switch->header);
+    }
+    return false;
+}
+
+bool Writer::handle(const Reader::RecordSwitchType* context_switch)
+{
+    if (reorder_buffer_.enabled())
+    {
+        reorder_buffer_.push(context_switch->time, &context_switch->header,
+                             [this](const perf_event_header* record) { release(record); });
+    }
+    else
+    {
+        release(&context_switch->header);
+    }
+    return false;
+}
+
+void Writer::write_switch(const Reader::RecordSwitchCpuWideType* context_switch)
 {
     assert(cpuid_ != -1);
     auto tp = time_converter_(context_switch->time);
@@ -242,11 +568,9 @@ bool Writer::handle(const Reader::RecordSwitchCpuWideType* context_switch)
 
     update_calling_context(context_switch->pid, context_switch->tid, tp,
                            context_switch->header.misc & PERF_RECORD_MISC_SWITCH_OUT);
-
-    return false;
 }
 
-bool Writer::handle(const Reader::RecordSwitchType* context_switch)
+void Writer::write_switch(const Reader::RecordSwitchType* context_switch)
 {
     assert(cpuid_ == -1);
     auto tp = time_converter_(context_switch->time);
@@ -267,8 +591,6 @@ bool Writer::handle(const Reader::RecordSwitchType* context_switch)
         cpuid_metric_event_.raw_values()[0] = context_switch->cpu;
         otf2_writer_ << cpuid_metric_event_;
     }
-
-    return false;
 }
 
 void Writer::update_calling_context(pid_t pid, pid_t tid, otf2::chrono::time_point tp,
@@ -311,6 +633,14 @@ bool Writer::handle(const Reader::RecordCommType* comm)
 
 void Writer::end()
 {
+    reorder_buffer_.flush([this](const perf_event_header* record) { release(record); });
+#ifdef HAVE_LIBDW
+    if (unwinder_)
+    {
+        write_deferred();
+    }
+#endif
+
     if (cpuid_ == -1)
     {
         adjust_timepoints(lo2s::time::now());
@@ -51,7 +51,7 @@ namespace perf
 {
 namespace time
 {
-Reader::Reader()
+Reader::Reader() : EventReader(RingKind::TIME)
 {
     static_assert(sizeof(local_time) == 8, "The local time object must not be a big fat "
                                            "object, or the hardware breakpoint won't work.");
@@ -0,0 +1,107 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2017,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/tracepoint/format.hpp>
+
+#include <algorithm>
+#include <array>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+EventSpec::EventSpec(const std::string& spec)
+{
+    // The filter starts at the first '/' after the separator of group and name
+    auto separator = spec.find_first_of(":/");
+    auto filter_begin =
+        (separator == std::string::npos) ? std::string::npos : spec.find('/', separator + 1);
+
+    name = spec.substr(0, filter_begin);
+    if (filter_begin == std::string::npos)
+    {
+        return;
+    }
+
+    if (spec.back() != '/' || spec.size() == filter_begin + 1)
+    {
+        throw InvalidFilter("filter of tracepoint '" + spec + "' must be terminated by '/'");
+    }
+    filter = spec.substr(filter_begin + 1, spec.size() - filter_begin - 2);
+    if (filter.empty())
+    {
+        throw InvalidFilter("filter of tracepoint '" + spec + "' is empty");
+    }
+}
+
+void validate_filter(const std::string& event, const std::string& filter,
+                     const std::vector<EventField>& fields,
+                     const std::vector<EventField>& common_fields)
+{
+    // The kernel only answers EINVAL for any error in a filter, so at least check the field names
+    // here to give a useful error message. String constants may contain anything, skip them.
+    static const std::regex string_regex(R"("[^"]*")");
+    // The left hand side of a predicate, "&" but not "&&"
+    static const std::regex predicate_regex(
+        R"(([A-Za-z_][A-Za-z0-9_]*)\s*(==|!=|<=|>=|<|>|~|&(?!&)))");
+
+    // Fields the kernel provides for the filters of every event, they are not in the format
+    static const std::array<const char*, 5> generic_fields = { "CPU", "cpu", "common_cpu", "COMM",
+                                                               "comm" };
+
+    auto stripped = std::regex_replace(filter, string_regex, "\"\"");
+
+    bool has_predicate = false;
+    for (auto it = std::sregex_iterator(stripped.begin(), stripped.end(), predicate_regex);
+         it != std::sregex_iterator(); ++it)
+    {
+        const std::string field_name = (*it)[1];
+        auto has_name = [&field_name](const auto& field) { return field.name() == field_name; };
+        if (std::none_of(fields.begin(), fields.end(), has_name) &&
+            std::none_of(common_fields.begin(), common_fields.end(), has_name) &&
+            std::find(generic_fields.begin(), generic_fields.end(), field_name) ==
+                generic_fields.end())
+        {
+            std::string available;
+            for (const auto& field : fields)
+            {
+                available += (available.empty() ? "" : ", ") + field.name();
+            }
+            throw InvalidFilter("unknown field '" + field_name + "' in filter '" + filter +
+                                "' for tracepoint " + event + ", available fields: " + available);
+        }
+        has_predicate = true;
+    }
+
+    if (!has_predicate)
+    {
+        throw InvalidFilter("filter '" + filter + "' for tracepoint " + event +
+                            " does not compare any field");
+    }
+}
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
@@ -23,6 +23,7 @@
 
 #include <lo2s/log.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <regex>
@@ -121,6 +122,11 @@ void EventFormat::parse_format_line(const std::string& line)
     }
 }
 
+void EventFormat::validate_filter(const std::string& filter) const
+{
+    tracepoint::validate_filter(name_, filter, fields_, common_fields_);
+}
+
 std::vector<std::string> EventFormat::get_tracepoint_event_names()
 {
     try
@@ -46,7 +46,7 @@ static const EventFormat& get_sched_switch_event()
 }
 
 SwitchWriter::SwitchWriter(int cpu, trace::Trace& trace)
-try : Reader(cpu, get_sched_switch_event().id()),
+try : Reader(cpu, get_sched_switch_event().id(), std::string(), RingKind::SWITCH),
       otf2_writer_(trace.cpu_switch_writer(cpu)),
       trace_(trace),
       time_converter_(time::Converter::instance()),
@@ -54,6 +54,7 @@ try : Reader(cpu, get_sched_switch_event().id()),
       next_pid_field_(get_sched_switch_event().field("next_pid")),
       prev_state_field_(get_sched_switch_event().field("prev_state"))
 {
+    init_stats(trace, otf2_writer_.location());
 }
 // NOTE: function-try-block is intentional; catch get_sched_switch_event()
 // throwing in constructor initializers if sched/sched_switch tracepoint
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/tracepoint/syscall_writer.hpp>
+
+#include <lo2s/perf/tracepoint/format.hpp>
+
+#include <lo2s/perf/time/converter.hpp>
+
+#include <lo2s/config.hpp>
+#include <lo2s/log.hpp>
+#include <lo2s/time/time.hpp>
+#include <lo2s/trace/trace.hpp>
+
+#include <otf2xx/otf2.hpp>
+
+#include <chrono>
+#include <stdexcept>
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+
+static const EventFormat& get_sys_enter_event()
+{
+    static EventFormat evt("raw_syscalls/sys_enter");
+    return evt;
+}
+
+static const EventFormat& get_sys_exit_event()
+{
+    static EventFormat evt("raw_syscalls/sys_exit");
+    return evt;
+}
+
+SyscallWriter::SyscallWriter(pid_t pid, pid_t tid, trace::Trace& trace)
+try : Reader(tid, -1, get_sys_enter_event().id(), std::string(), RingKind::TRACEPOINT),
+      writer_(trace.thread_syscall_writer(pid, tid)),
+      trace_(trace),
+      time_converter_(time::Converter::instance()),
+      exit_id_(add_event(get_sys_exit_event().id())),
+      enter_nr_field_(get_sys_enter_event().field("id")),
+      exit_nr_field_(get_sys_exit_event().field("id")),
+      min_duration_(config().syscall_min_duration.count())
+{
+    init_stats(trace, writer_.location());
+}
+catch (const EventFormat::ParseError& e)
+{
+    Log::error() << "Failed to open raw_syscalls tracepoint events: " << e.what();
+    throw std::runtime_error("Failed to open syscall writer");
+}
+
+bool SyscallWriter::handle(const Reader::RecordSampleType* sample)
+{
+    if (sample->id == exit_id_)
+    {
+        // Exits without a matching enter belong to the syscall the thread was in when we attached, or
+        // their enter was lost
+        if (in_syscall_)
+        {
+            int64_t nr = sample->raw_data.get(exit_nr_field_);
+            if (nr == syscall_nr_)
+            {
+                write(sample->time);
+            }
+            in_syscall_ = false;
+        }
+        return false;
+    }
+
+    // The exit of the previous syscall got lost, it ended before this one at the latest
+    if (in_syscall_)
+    {
+        write(sample->time);
+    }
+    in_syscall_ = true;
+    syscall_nr_ = sample->raw_data.get(enter_nr_field_);
+    enter_time_ = sample->time;
+    return false;
+}
+
+void SyscallWriter::write(uint64_t exit_time)
+{
+    if (exit_time - enter_time_ < min_duration_)
+    {
+        dropped_++;
+        return;
+    }
+
+    // The enter is only written once the duration is known, the location stays ordered as the
+    // syscalls of one thread do not overlap
+    const auto& region = trace_.syscall_region(syscall_nr_);
+    writer_ << otf2::event::enter(time_converter_(enter_time_), region);
+    writer_ << otf2::event::leave(time_converter_(exit_time), region);
+}
+
+void SyscallWriter::end()
+{
+    if (in_syscall_)
+    {
+        auto now = lo2s::time::now();
+        auto enter = time_converter_(enter_time_);
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(now - enter);
+        if (now >= enter && static_cast<uint64_t>(duration.count()) >= min_duration_)
+        {
+            const auto& region = trace_.syscall_region(syscall_nr_);
+            writer_ << otf2::event::enter(enter, region);
+            writer_ << otf2::event::leave(now, region);
+        }
+        in_syscall_ = false;
+    }
+
+    Log::debug() << "Dropped " << dropped_ << " syscalls shorter than --syscall-min-duration";
+}
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
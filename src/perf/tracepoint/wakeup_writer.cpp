@@ -0,0 +1,142 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lo2s/perf/tracepoint/wakeup_writer.hpp>
+
+#include <lo2s/perf/tracepoint/writer.hpp>
+
+#include <lo2s/perf/tracepoint/format.hpp>
+#include <lo2s/perf/tracepoint/wakeup_table.hpp>
+
+#include <lo2s/perf/time/converter.hpp>
+
+#include <lo2s/log.hpp>
+#include <lo2s/summary.hpp>
+#include <lo2s/trace/trace.hpp>
+
+#include <fmt/core.h>
+
+extern "C"
+{
+#include <sys/types.h>
+}
+
+namespace lo2s
+{
+namespace perf
+{
+namespace tracepoint
+{
+
+static const EventFormat& get_sched_switch_event()
+{
+    static EventFormat evt("sched/sched_switch");
+    return evt;
+}
+
+static const EventFormat& get_sched_wakeup_event()
+{
+    static EventFormat evt("sched/sched_wakeup");
+    return evt;
+}
+
+static const EventFormat& get_sched_wakeup_new_event()
+{
+    static EventFormat evt("sched/sched_wakeup_new");
+    return evt;
+}
+
+WakeupWriter::WakeupWriter(int cpu, trace::Trace& trace,
+                           const std::function<uint64_t(int)>& add_event)
+try : writer_(trace.named_metric_writer(fmt::format("runqueue latency for CPU {}", cpu))),
+      metric_event_(otf2::chrono::genesis(),
+                    trace.metric_instance(trace.runqueue_latency_metric_class(),
+                                          writer_.location(), trace.system_tree_cpu_node(cpu))),
+      time_converter_(time::Converter::instance()),
+      switch_id_(add_event(get_sched_switch_event().id())),
+      wakeup_id_(add_event(get_sched_wakeup_event().id())),
+      wakeup_new_id_(add_event(get_sched_wakeup_new_event().id())),
+      prev_pid_field_(get_sched_switch_event().field("prev_pid")),
+      next_pid_field_(get_sched_switch_event().field("next_pid")),
+      wakeup_pid_field_(get_sched_wakeup_event().field("pid")),
+      wakeup_new_pid_field_(get_sched_wakeup_new_event().field("pid"))
+{
+}
+catch (const EventFormat::ParseError& e)
+{
+    Log::error() << "Failed to open scheduler tracepoint events: " << e.what();
+    throw std::runtime_error("Failed to open wakeup latency writer");
+}
+
+WakeupWriter::~WakeupWriter()
+{
+    summary().record_runqueue_latencies(histogram_, late_latencies_);
+}
+
+bool WakeupWriter::handle(const Reader<Writer>::RecordSampleType* sample)
+{
+    auto& table = WakeupTable::instance();
+
+    if (sample->id == wakeup_id_ || sample->id == wakeup_new_id_)
+    {
+        pid_t pid = sample->raw_data.get(sample->id == wakeup_id_ ? wakeup_pid_field_
+                                                                  : wakeup_new_pid_field_);
+        auto latency = table.wakeup(pid, sample->time);
+        if (latency >= 0)
+        {
+            histogram_.add(latency);
+            late_latencies_++;
+        }
+    }
+    else if (sample->id == switch_id_)
+    {
+        pid_t prev_pid = sample->raw_data.get(prev_pid_field_);
+        pid_t next_pid = sample->raw_data.get(next_pid_field_);
+
+        if (prev_pid != 0)
+        {
+            table.switch_out(prev_pid, sample->time);
+        }
+        if (next_pid == 0)
+        {
+            return true;
+        }
+
+        auto latency = table.switch_in(next_pid, sample->time);
+        if (latency >= 0)
+        {
+            histogram_.add(latency);
+
+            metric_event_.timestamp(time_converter_(sample->time));
+            metric_event_.raw_values()[0] = static_cast<uint64_t>(latency);
+            metric_event_.raw_values()[1] = static_cast<uint64_t>(next_pid);
+            writer_.write(metric_event_);
+        }
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+} // namespace tracepoint
+} // namespace perf
+} // namespace lo2s
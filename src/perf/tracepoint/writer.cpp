@@ -1,4 +1,5 @@
 #include <lo2s/config.hpp>
+#include <lo2s/log.hpp>
 #include <lo2s/perf/time/converter.hpp>
 #include <lo2s/perf/tracepoint/format.hpp>
 #include <lo2s/perf/tracepoint/writer.hpp>
@@ -14,32 +15,81 @@ namespace perf
 namespace tracepoint
 {
 
-Writer::Writer(int cpu, const EventFormat& event, trace::Trace& trace_,
-               const otf2::definition::metric_class& metric_class)
-: Reader(cpu, event.id()), event_(event),
-  writer_(trace_.named_metric_writer(fmt::format("tracepoint metrics for CPU {}", cpu))),
-  metric_instance_(
-      trace_.metric_instance(metric_class, writer_.location(), trace_.system_tree_cpu_node(cpu))),
-  time_converter_(perf::time::Converter::instance()),
-  metric_event_(otf2::chrono::genesis(), metric_instance_)
+// The tracepoint that the ring buffer is opened with, all others are added to it
+static EventSpec first_event(const std::vector<std::string>& tracepoints)
 {
+    return EventSpec(tracepoints.empty() ? WakeupWriter::first_event : tracepoints.front());
+}
+
+Writer::Writer(int cpu, trace::Trace& trace, const std::vector<std::string>& tracepoints,
+               bool wakeup_latency)
+: Reader(cpu, EventFormat(first_event(tracepoints).name).id(), first_event(tracepoints).filter),
+  time_converter_(perf::time::Converter::instance())
+{
+    if (!tracepoints.empty())
+    {
+        writer_ = &trace.named_metric_writer(fmt::format("tracepoint metrics for CPU {}", cpu));
+    }
+
+    for (const auto& tracepoint : tracepoints)
+    {
+        EventSpec spec(tracepoint);
+        EventFormat event(spec.name);
+
+        auto id = record(event.id(), spec.filter);
+        auto metric_instance =
+            trace.metric_instance(trace.tracepoint_metric_class(tracepoint), writer_->location(),
+                                  trace.system_tree_cpu_node(cpu));
+        events_.emplace(std::piecewise_construct, std::forward_as_tuple(id),
+                        std::forward_as_tuple(event, metric_instance));
+    }
+
+    if (wakeup_latency)
+    {
+        wakeup_writer_ = std::make_unique<WakeupWriter>(
+            cpu, trace, [this](int event_id) { return record(event_id, std::string()); });
+    }
+
+    init_stats(trace, writer_ != nullptr ? writer_->location() : wakeup_writer_->location());
+}
+
+uint64_t Writer::record(int event_id, const std::string& filter)
+{
+    if (!first_recorded_)
+    {
+        first_recorded_ = true;
+        return Reader::id();
+    }
+    return add_event(event_id, filter);
 }
 
 bool Writer::handle(const Reader::RecordSampleType* sample)
 {
-    metric_event_.timestamp(time_converter_(sample->time));
+    auto it = events_.find(sample->id);
+    if (it == events_.end())
+    {
+        if (wakeup_writer_ && wakeup_writer_->handle(sample))
+        {
+            return false;
+        }
+        Log::warn() << "tracepoint record with unknown sample id " << sample->id;
+        return false;
+    }
+    auto& event = it->second;
+
+    event.metric_event.timestamp(time_converter_(sample->time));
 
     std::size_t index = 0;
-    for (const auto& field : event_.fields())
+    for (const auto& field : event.format.fields())
     {
         if (!field.is_integer())
         {
             continue;
         }
 
-        metric_event_.raw_values()[index++] = sample->raw_data.get(field);
+        event.metric_event.raw_values()[index++] = sample->raw_data.get(field);
     }
-    writer_.write(metric_event_);
+    writer_->write(event.metric_event);
     return false;
 }
 } // namespace tracepoint
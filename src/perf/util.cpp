@@ -45,14 +45,16 @@ struct perf_event_attr common_perf_event_attrs()
     attr.use_clockid = config().use_clockid;
     attr.clockid = config().clockid;
 #endif
-    // When we poll on the fd given by perf_event_open, wakeup, when our buffer is 80% full
-    // Default behaviour is to wakeup on every event, which is horrible performance wise
-    attr.watermark = 1;
-    attr.wakeup_watermark = static_cast<uint32_t>(0.8 * config().mmap_pages * get_page_size());
 
     return attr;
 }
 
+void set_wakeup_watermark(struct perf_event_attr& attr, std::size_t mmap_pages)
+{
+    attr.watermark = 1;
+    attr.wakeup_watermark = static_cast<uint32_t>(0.8 * mmap_pages * get_page_size());
+}
+
 void perf_warn_paranoid()
 {
     static bool warning_issued = false;
@@ -1,15 +1,15 @@
 #include <lo2s/config.hpp>
+#include <lo2s/log.hpp>
 #include <lo2s/summary.hpp>
 #include <lo2s/util.hpp>
 
-#include <filesystem>
-
 #include <array>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
 #include <ratio>
+#include <sstream>
 
 extern "C"
 {
@@ -42,6 +42,39 @@ void Summary::record_perf_wakeups(std::size_t num_wakeups)
     num_wakeups_ += num_wakeups;
 }
 
+void Summary::record_monitor(const std::string& name, std::size_t num_wakeups,
+                             std::chrono::nanoseconds cpu_time)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    monitors_.push_back({ name, num_wakeups, cpu_time });
+}
+
+void Summary::record_reader(const std::string& name, std::uint64_t records, std::uint64_t lost,
+                            std::uint64_t throttled)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    readers_.push_back({ name, records, lost, throttled });
+}
+
+void Summary::record_phase(const std::string& phase, std::chrono::nanoseconds duration)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    phases_[phase] += duration;
+}
+
+void Summary::record_location_size(const std::string& name, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    location_sizes_.emplace_back(name, size);
+}
+
+void Summary::record_runqueue_latencies(const LatencyHistogram& latencies, std::uint64_t late)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    runqueue_latencies_.merge(latencies);
+    late_runqueue_latencies_ += late;
+}
+
 void Summary::set_exit_code(int exit_code)
 {
     exit_code_ = exit_code;
@@ -81,31 +114,151 @@ void Summary::set_trace_dir(const std::string& trace_dir)
     trace_dir_ = trace_dir;
 }
 
-void Summary::show()
+static std::string json_string(const std::string& str)
 {
+    std::ostringstream out;
+    out << '"';
+    for (char c : str)
+    {
+        switch (c)
+        {
+        case '"':
+            out << "\\\"";
+            break;
+        case '\\':
+            out << "\\\\";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                    << std::dec;
+            }
+            else
+            {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+    return out.str();
+}
 
-    std::size_t trace_size;
-
-    if (config().quiet)
+void Summary::write_stats_file(std::chrono::duration<double> wall_time,
+                               std::chrono::duration<double> cpu_time, std::size_t trace_size)
+{
+    std::ofstream out(config().stats_file);
+    if (!out)
     {
+        Log::error() << "Could not open statistics file " << config().stats_file;
         return;
     }
 
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+
+    out << "{\n";
+    out << "  \"trace_dir\": " << json_string(trace_dir_) << ",\n";
+    out << "  \"exit_code\": " << exit_code_ << ",\n";
+    out << "  \"threads\": " << thread_count_ << ",\n";
+    out << "  \"wall_time_s\": " << wall_time.count() << ",\n";
+    out << "  \"cpu_time_s\": " << cpu_time.count() << ",\n";
+    out << "  \"peak_rss_bytes\": " << get_peak_rss() << ",\n";
+    out << "  \"wakeups\": " << num_wakeups_ << ",\n";
+    out << "  \"trace_bytes\": " << trace_size << ",\n";
+
+    out << "  \"phases_s\": {";
+    const char* sep = "\n";
+    for (const auto& phase : phases_)
+    {
+        out << sep << "    " << json_string(phase.first) << ": "
+            << std::chrono::duration<double>(phase.second).count();
+        sep = ",\n";
+    }
+    out << "\n  },\n";
+
+    out << "  \"monitors\": [";
+    sep = "\n";
+    for (const auto& monitor : monitors_)
+    {
+        out << sep << "    { \"name\": " << json_string(monitor.name)
+            << ", \"wakeups\": " << monitor.num_wakeups << ", \"cpu_time_s\": "
+            << std::chrono::duration<double>(monitor.cpu_time).count() << " }";
+        sep = ",\n";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"readers\": [";
+    sep = "\n";
+    for (const auto& reader : readers_)
+    {
+        out << sep << "    { \"name\": " << json_string(reader.name)
+            << ", \"records\": " << reader.records << ", \"lost\": " << reader.lost
+            << ", \"throttled\": " << reader.throttled << " }";
+        sep = ",\n";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"locations\": [";
+    sep = "\n";
+    for (const auto& location : location_sizes_)
+    {
+        out << sep << "    { \"name\": " << json_string(location.first)
+            << ", \"bytes\": " << location.second << " }";
+        sep = ",\n";
+    }
+    out << "\n  ]";
+
+    if (config().wakeup_latency)
+    {
+        out << ",\n  \"runqueue_latency\": {\n";
+        out << "    \"count\": " << runqueue_latencies_.count() << ",\n";
+        out << "    \"sum_ns\": " << runqueue_latencies_.sum() << ",\n";
+        out << "    \"max_ns\": " << runqueue_latencies_.max() << ",\n";
+        out << "    \"not_in_trace\": " << late_runqueue_latencies_ << ",\n";
+        // Bucket i holds the latencies below 2^i ns, that are not in a lower bucket
+        out << "    \"buckets\": [";
+        sep = "\n";
+        const auto& buckets = runqueue_latencies_.buckets();
+        for (std::size_t i = 0; i < buckets.size(); i++)
+        {
+            if (buckets[i] == 0)
+            {
+                continue;
+            }
+            out << sep << "      { \"below_ns\": " << LatencyHistogram::upper_bound(i)
+                << ", \"count\": " << buckets[i] << " }";
+            sep = ",\n";
+        }
+        out << "\n    ]\n  }";
+    }
+    out << "\n}\n";
+}
+
+void Summary::show()
+{
     std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start_wall_time_;
 
     std::chrono::duration<double> cpu_time = get_cpu_time();
 
-    std::filesystem::recursive_directory_iterator it(trace_dir_), end;
+    // The trace records the size of each location file once the archive is closed, so there is
+    // no need to walk the whole trace directory here.
+    std::size_t trace_size;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        trace_size = std::accumulate(
+            location_sizes_.begin(), location_sizes_.end(), static_cast<std::size_t>(0),
+            [](std::size_t sum, const auto& location) { return sum + location.second; });
+    }
+
+    if (!config().stats_file.empty())
+    {
+        write_stats_file(wall_time, cpu_time, trace_size);
+    }
 
-    trace_size =
-        std::accumulate(it, end, static_cast<size_t>(0),
-                        [](std::size_t sum, const std::filesystem::directory_entry& entry) {
-                            if (!std::filesystem::is_directory(entry))
-                            {
-                                return sum + std::filesystem::file_size(entry);
-                            }
-                            return sum;
-                        });
+    if (config().quiet)
+    {
+        return;
+    }
 
     if (config().monitor_type == lo2s::MonitorType::PROCESS)
     {
@@ -148,5 +301,20 @@ void Summary::show()
     }
 
     std::cout << " ]\n";
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    if (config().wakeup_latency && runqueue_latencies_.count() > 0)
+    {
+        auto us = [](std::uint64_t ns) { return ns / 1000.0; };
+        std::cout << "[ lo2s: runqueue latency of " << runqueue_latencies_.count()
+                  << " wakeups: median <= " << us(runqueue_latencies_.quantile(0.5))
+                  << "us, 99th percentile <= " << us(runqueue_latencies_.quantile(0.99))
+                  << "us, max " << us(runqueue_latencies_.max()) << "us";
+        if (late_runqueue_latencies_ > 0)
+        {
+            std::cout << ", " << late_runqueue_latencies_ << " not in the trace";
+        }
+        std::cout << " ]\n";
+    }
 }
 } // namespace lo2s
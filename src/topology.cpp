@@ -1,42 +1,10 @@
 #include <lo2s/topology.hpp>
+#include <lo2s/util.hpp>
 
 namespace lo2s
 {
 const std::filesystem::path Topology::base_path = "/sys/devices/system/cpu";
 
-namespace detail
-{
-static auto parse_list(std::string list) -> std::set<uint32_t>
-{
-    std::stringstream s;
-    s << list;
-
-    std::set<uint32_t> res;
-
-    std::string part;
-    while (std::getline(s, part, ','))
-    {
-        auto pos = part.find('-');
-        if (pos != std::string::npos)
-        {
-            // is a range
-            uint32_t from = std::stoi(part.substr(0, pos));
-            uint32_t to = std::stoi(part.substr(pos + 1));
-
-            for (auto i = from; i <= to; ++i)
-                res.insert(i);
-        }
-        else
-        {
-            // single value
-            res.insert(std::stoi(part));
-        }
-    }
-
-    return res;
-}
-} // namespace detail
-
 void Topology::read_proc()
 {
     std::string online_list;
@@ -50,8 +18,8 @@ void Topology::read_proc()
         std::getline(cpu_present, present_list);
     }
 
-    auto online = detail::parse_list(online_list);
-    auto present = detail::parse_list(present_list);
+    auto online = parse_list(online_list);
+    auto present = parse_list(present_list);
 
     for (auto cpu_id : online)
     {
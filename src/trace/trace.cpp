@@ -27,6 +27,7 @@
 #include <lo2s/line_info.hpp>
 #include <lo2s/mmap.hpp>
 #include <lo2s/perf/tracepoint/format.hpp>
+#include <lo2s/perf/tracepoint/syscalls.hpp>
 #include <lo2s/summary.hpp>
 #include <lo2s/time/time.hpp>
 #include <lo2s/topology.hpp>
@@ -86,14 +87,22 @@ std::string get_trace_name(std::string prefix = "")
 Trace::Trace()
 : trace_name_(get_trace_name(config().trace_path)), archive_(trace_name_, "traces"),
   registry_(archive_.registry()),
-  interrupt_generator_(registry_.create<otf2::definition::interrupt_generator>(
-      intern("perf HW_INSTRUCTIONS"), otf2::common::interrupt_generator_mode_type::count,
-      otf2::common::base_type::decimal, 0, config().sampling_period)),
+  interrupt_generator_(
+      config().sampling_use_frequency ?
+          registry_.create<otf2::definition::interrupt_generator>(
+              intern("perf HW_INSTRUCTIONS"), otf2::common::interrupt_generator_mode_type::time,
+              otf2::common::base_type::decimal, -9, 1000000000 / config().sampling_frequency) :
+          registry_.create<otf2::definition::interrupt_generator>(
+              intern("perf HW_INSTRUCTIONS"), otf2::common::interrupt_generator_mode_type::count,
+              otf2::common::base_type::decimal, 0, config().sampling_period)),
   comm_locations_group_(registry_.create<otf2::definition::comm_locations_group>(
       intern("All pthread locations"), otf2::common::paradigm_type::pthread,
       otf2::common::group_flag_type::none)),
   lo2s_regions_group_(registry_.create<otf2::definition::regions_group>(
       intern("lo2s"), otf2::common::paradigm_type::user, otf2::common::group_flag_type::none)),
+  syscall_regions_group_(registry_.create<otf2::definition::regions_group>(
+      intern("syscalls"), otf2::common::paradigm_type::user,
+      otf2::common::group_flag_type::none)),
   system_tree_root_node_(registry_.create<otf2::definition::system_tree_node>(
       intern(nitro::env::hostname()), intern("machine")))
 {
@@ -193,6 +202,13 @@ Trace::~Trace()
 
     archive_ << otf2::definition::clock_properties(starting_time_, stopping_time_);
 
+    summary().record_phase("calling context merge", cctx_merge_time_ - symbolization_time_);
+    summary().record_phase("symbolization", symbolization_time_);
+
+    // The definitions are written once archive_ is destroyed, right after this
+    archive_stats_.trace_name = trace_name_;
+    archive_stats_.close_start = std::chrono::steady_clock::now();
+
     std::filesystem::path symlink_path = nitro::env::get("LO2S_OUTPUT_LINK");
 
     if (symlink_path.empty())
@@ -335,7 +351,7 @@ otf2::writer::local& Trace::thread_sample_writer(pid_t pid, pid_t tid)
 
     comm_locations_group_.add_member(location);
 
-    return archive_(location);
+    return location_writer(location);
 }
 
 otf2::writer::local& Trace::cpu_sample_writer(int cpuid)
@@ -354,7 +370,7 @@ otf2::writer::local& Trace::cpu_sample_writer(int cpuid)
         otf2::definition::location::location_type::cpu_thread);
 
     comm_locations_group_.add_member(location);
-    return archive_(location);
+    return location_writer(location);
 #endif
 }
 
@@ -370,7 +386,7 @@ otf2::writer::local& Trace::cpu_switch_writer(int cpuid)
         otf2::definition::location::location_type::cpu_thread);
 
     comm_locations_group_.add_member(location);
-    return archive_(location);
+    return location_writer(location);
 }
 
 otf2::writer::local& Trace::thread_metric_writer(pid_t pid, pid_t tid)
@@ -384,7 +400,31 @@ otf2::writer::local& Trace::thread_metric_writer(pid_t pid, pid_t tid)
         registry_.get<otf2::definition::location_group>(ByProcess(pid)),
         otf2::definition::location::location_type::metric);
 
-    return archive_(location);
+    return location_writer(location);
+}
+
+otf2::writer::local& Trace::thread_off_cpu_writer(pid_t pid, pid_t tid)
+{
+    auto name = fmt::format("off-CPU thread {}", tid);
+
+    const auto& location = registry_.emplace<otf2::definition::location>(
+        ByThreadOffCpuWriter(tid), intern(name),
+        registry_.get<otf2::definition::location_group>(ByProcess(pid)),
+        otf2::definition::location::location_type::cpu_thread);
+
+    return location_writer(location);
+}
+
+otf2::writer::local& Trace::thread_syscall_writer(pid_t pid, pid_t tid)
+{
+    auto name = fmt::format("syscalls thread {}", tid);
+
+    const auto& location = registry_.emplace<otf2::definition::location>(
+        ByThreadSyscallWriter(tid), intern(name),
+        registry_.get<otf2::definition::location_group>(ByProcess(pid)),
+        otf2::definition::location::location_type::cpu_thread);
+
+    return location_writer(location);
 }
 
 otf2::writer::local& Trace::cpu_metric_writer(int cpuid)
@@ -395,7 +435,7 @@ otf2::writer::local& Trace::cpu_metric_writer(int cpuid)
         ByCpuMetricWriter(cpuid), name,
         registry_.get<otf2::definition::location_group>(ByCpu(cpuid)),
         otf2::definition::location::location_type::metric);
-    return archive_(location);
+    return location_writer(location);
 }
 
 otf2::writer::local& Trace::named_metric_writer(const std::string& name)
@@ -404,9 +444,45 @@ otf2::writer::local& Trace::named_metric_writer(const std::string& name)
     const auto& location = registry_.create<otf2::definition::location>(
         intern(name), registry_.get<otf2::definition::location_group>(ByProcess(METRIC_PID)),
         otf2::definition::location::location_type::metric);
+    return location_writer(location);
+}
+
+otf2::writer::local& Trace::location_writer(const otf2::definition::location& location)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    archive_stats_.locations.emplace(location.ref(), location.name().str());
     return archive_(location);
 }
 
+Trace::ArchiveStats::~ArchiveStats()
+{
+    // Runs after the archive has been closed, so all files have their final size
+    summary().record_phase("definition write", std::chrono::steady_clock::now() - close_start);
+
+    std::filesystem::path trace_dir(trace_name);
+    std::error_code ec;
+
+    std::size_t global_size = 0;
+    for (const auto& file : { "traces.otf2", "traces.def" })
+    {
+        auto size = std::filesystem::file_size(trace_dir / file, ec);
+        global_size += ec ? 0 : size;
+    }
+    summary().record_location_size("global definitions", global_size);
+
+    for (const auto& location : locations)
+    {
+        std::size_t location_size = 0;
+        for (const auto& extension : { ".evt", ".def" })
+        {
+            auto size = std::filesystem::file_size(
+                trace_dir / "traces" / (std::to_string(location.first) + extension), ec);
+            location_size += ec ? 0 : size;
+        }
+        summary().record_location_size(location.second, location_size);
+    }
+}
+
 otf2::definition::metric_member
 Trace::metric_member(const std::string& name, const std::string& description,
                      otf2::common::metric_mode mode, otf2::common::type value_type,
@@ -441,7 +517,9 @@ otf2::definition::metric_class& Trace::tracepoint_metric_class(const std::string
             ByString(event_name), otf2::common::metric_occurence::async,
             otf2::common::recorder_kind::abstract);
 
-        perf::tracepoint::EventFormat event(event_name);
+        // The members are named after the whole event name including the filter, to tell
+        // differently filtered recordings of the same tracepoint apart
+        perf::tracepoint::EventFormat event(perf::tracepoint::EventSpec(event_name).name);
         for (const auto& field : event.fields())
         {
             if (field.is_integer())
@@ -459,6 +537,39 @@ otf2::definition::metric_class& Trace::tracepoint_metric_class(const std::string
     }
 }
 
+otf2::definition::metric_class& Trace::uncore_metric_class(const std::string& pmu)
+{
+    // Use the perf syntax "pmu/" as key, which can not clash with tracepoint names
+    const auto key = ByString(pmu + "/");
+    if (!registry_.has<otf2::definition::metric_class>(key))
+    {
+        auto& mc = registry_.create<otf2::definition::metric_class>(
+            key, otf2::common::metric_occurence::async, otf2::common::recorder_kind::abstract);
+
+        for (const auto& counter : perf::counter::requested_counters().uncore_counters)
+        {
+            if (counter.pmu == pmu)
+            {
+                mc.add_member(metric_member(counter.name, counter.name,
+                                            otf2::common::metric_mode::accumulated_start,
+                                            otf2::common::type::Double, counter.unit));
+            }
+        }
+
+        mc.add_member(metric_member("time_enabled", "time event active",
+                                    otf2::common::metric_mode::accumulated_start,
+                                    otf2::common::type::uint64, "ns"));
+        mc.add_member(metric_member("time_running", "time event on CPU",
+                                    otf2::common::metric_mode::accumulated_start,
+                                    otf2::common::type::uint64, "ns"));
+        return mc;
+    }
+    else
+    {
+        return registry_.get<otf2::definition::metric_class>(key);
+    }
+}
+
 otf2::definition::metric_class& Trace::metric_class()
 {
     return registry_.create<otf2::definition::metric_class>(otf2::common::metric_occurence::async,
@@ -480,8 +591,10 @@ void Trace::merge_ips(IpRefMap& new_children, IpCctxMap& children,
         auto info_it = infos.find(pid);
         if (info_it != infos.end())
         {
+            auto lookup_start = std::chrono::steady_clock::now();
             MemoryMap maps = info_it->second.maps();
             line_info = maps.lookup_line_info(ip);
+            symbolization_time_ += std::chrono::steady_clock::now() - lookup_start;
         }
 
         Log::trace() << "resolved " << ip << ": " << line_info;
@@ -522,6 +635,7 @@ otf2::definition::mapping_table Trace::merge_calling_contexts(ThreadCctxRefMap&
                                                               std::map<pid_t, ProcessInfo>& infos)
 {
     std::lock_guard<std::recursive_mutex> guard(mutex_);
+    auto merge_start = std::chrono::steady_clock::now();
 #ifndef NDEBUG
     std::vector<uint32_t> mappings(num_ip_refs, -1u);
 #else
@@ -571,6 +685,8 @@ otf2::definition::mapping_table Trace::merge_calling_contexts(ThreadCctxRefMap&
     }
 #endif
 
+    cctx_merge_time_ += std::chrono::steady_clock::now() - merge_start;
+
     return otf2::definition::mapping_table(
         otf2::definition::mapping_table::mapping_type_type::calling_context, mappings);
 }
@@ -645,6 +761,23 @@ void Trace::add_threads(const std::unordered_map<pid_t, std::string>& tid_map)
     }
 }
 
+const otf2::definition::region& Trace::syscall_region(int64_t nr)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+
+    if (registry_.has<otf2::definition::region>(BySyscall(nr)))
+    {
+        return registry_.get<otf2::definition::region>(BySyscall(nr));
+    }
+
+    const auto& name = intern(perf::tracepoint::syscall_name(nr));
+    const auto& region = registry_.create<otf2::definition::region>(
+        BySyscall(nr), name, name, name, otf2::common::role_type::function,
+        otf2::common::paradigm_type::user, otf2::common::flags_type::none, intern("kernel"), 0, 0);
+    syscall_regions_group_.add_member(region);
+    return region;
+}
+
 const otf2::definition::source_code_location& Trace::intern_scl(const LineInfo& info)
 {
     return registry_.emplace<otf2::definition::source_code_location>(ByLineInfo(info),
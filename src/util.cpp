@@ -10,6 +10,7 @@
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
 
 #include <cstdint>
@@ -35,6 +36,36 @@ std::size_t get_page_size()
     return page_size;
 }
 
+std::set<uint32_t> parse_list(const std::string& list)
+{
+    std::stringstream s;
+    s << list;
+
+    std::set<uint32_t> res;
+
+    std::string part;
+    while (std::getline(s, part, ','))
+    {
+        auto pos = part.find('-');
+        if (pos != std::string::npos)
+        {
+            // is a range
+            uint32_t from = std::stoi(part.substr(0, pos));
+            uint32_t to = std::stoi(part.substr(pos + 1));
+
+            for (auto i = from; i <= to; ++i)
+                res.insert(i);
+        }
+        else
+        {
+            // single value
+            res.insert(std::stoi(part));
+        }
+    }
+
+    return res;
+}
+
 std::chrono::duration<double> get_cpu_time()
 {
     struct rusage usage, child_usage;
@@ -59,6 +90,17 @@ std::chrono::duration<double> get_cpu_time()
     return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
 }
 
+std::size_t get_peak_rss()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == -1)
+    {
+        return 0;
+    }
+    // ru_maxrss is given in KiB
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
 std::string get_process_exe(pid_t pid)
 {
     auto proc_exe_filename = fmt::format("/proc/{}/exe", pid);
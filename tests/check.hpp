@@ -0,0 +1,56 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+/* The unit tests are plain executables without a test framework. CHECK reports every failed
+ * condition, the test fails if any did.
+ */
+namespace lo2s
+{
+namespace test
+{
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void check(bool condition, const char* expression, const char* file, int line)
+{
+    if (!condition)
+    {
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+        failures()++;
+    }
+}
+
+inline int result()
+{
+    return failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+} // namespace test
+} // namespace lo2s
+
+#define CHECK(condition) lo2s::test::check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compiles derived metric expressions and evaluates them on fixed counter values.
+ */
+
+#include "check.hpp"
+
+#include <lo2s/perf/counter/derived_metric.hpp>
+
+#include <string>
+#include <vector>
+
+using lo2s::perf::counter::DerivedMetric;
+
+namespace
+{
+const std::vector<std::string> variables = { "cycles", "instructions", "idle" };
+const std::vector<double> values = { 4, 12, 0 };
+
+double evaluate(const std::string& expression)
+{
+    return DerivedMetric("m=" + expression, variables).evaluate(values);
+}
+
+bool invalid(const std::string& definition)
+{
+    try
+    {
+        DerivedMetric(definition, variables);
+    }
+    catch (const DerivedMetric::InvalidExpression&)
+    {
+        return true;
+    }
+    return false;
+}
+
+// 1+(1+(1+...)) keeps all n operands on the stack at once
+std::string right_nested_sum(std::size_t n)
+{
+    std::string expression = "1";
+    for (std::size_t i = 1; i < n; i++)
+    {
+        expression = "1+(" + expression + ")";
+    }
+    return expression;
+}
+} // namespace
+
+int main()
+{
+    {
+        DerivedMetric metric("ipc={instructions}/cycles", variables);
+        CHECK(metric.name() == "ipc");
+        CHECK(metric.expression() == "{instructions}/cycles");
+        CHECK(metric.evaluate(values) == 3);
+    }
+
+    // Precedence and associativity
+    CHECK(evaluate("1+2*3") == 7);
+    CHECK(evaluate("(1+2)*3") == 9);
+    CHECK(evaluate("8-3-2") == 3);
+    CHECK(evaluate("16/4/2") == 2);
+    CHECK(evaluate("2*3-4/2+1") == 5);
+
+    // Unary minus and parentheses
+    CHECK(evaluate("-2*3") == -6);
+    CHECK(evaluate("--2") == 2);
+    CHECK(evaluate("-(1-4)") == 3);
+    CHECK(evaluate(" ( ( cycles ) ) ") == 4);
+    CHECK(evaluate("cycles--instructions") == 16);
+
+    // Division by zero yields 0
+    CHECK(evaluate("cycles/idle") == 0);
+    CHECK(evaluate("1/(cycles-4)") == 0);
+
+    // Unknown variables and syntax errors
+    CHECK(invalid("m=branches"));
+    CHECK(invalid("m={cycles"));
+    CHECK(invalid("m=(1+2"));
+    CHECK(invalid("m=1+"));
+    CHECK(invalid("m="));
+    CHECK(invalid("m=1 2"));
+    CHECK(invalid("=1"));
+    CHECK(invalid("cycles"));
+
+    // The evaluation stack holds 32 entries
+    CHECK(evaluate(right_nested_sum(DerivedMetric::max_stack_depth)) ==
+          DerivedMetric::max_stack_depth);
+    CHECK(invalid("m=" + right_nested_sum(DerivedMetric::max_stack_depth + 1)));
+
+    // Nesting is bounded, although it does not grow the stack
+    CHECK(evaluate(std::string(64, '(') + "1" + std::string(64, ')')) == 1);
+    CHECK(invalid("m=" + std::string(100000, '(') + "1" + std::string(100000, ')')));
+    CHECK(invalid("m=" + std::string(100000, '-') + "1"));
+
+    return lo2s::test::result();
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Checks that the retry of perf_event_open with kernel.perf_event_paranoid > 1 never sets
+ * exclude_* flags on events of uncore PMUs, which refuse them.
+ */
+
+#include "check.hpp"
+
+#include <lo2s/perf/event_description.hpp>
+#include <lo2s/perf/util.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+using lo2s::perf::exclude_kernel_fallback;
+
+namespace
+{
+struct perf_event_attr empty_attr()
+{
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    return attr;
+}
+
+bool excludes_anything(const struct perf_event_attr& attr)
+{
+    return attr.exclude_user || attr.exclude_kernel || attr.exclude_hv || attr.exclude_idle ||
+           attr.exclude_host || attr.exclude_guest || attr.exclude_callchain_kernel ||
+           attr.exclude_callchain_user;
+}
+} // namespace
+
+int main()
+{
+    lo2s::perf::EventDescription core("cpu/instructions/", PERF_TYPE_RAW, 0xc0);
+    lo2s::perf::EventDescription uncore("uncore_imc_0/cas_count_read/",
+                                        static_cast<perf_type_id>(16), 0x304);
+    uncore.cpus = { 0, 28 };
+    CHECK(!core.uncore());
+    CHECK(uncore.uncore());
+
+    // Core events are retried in user space only, once
+    auto attr = empty_attr();
+    CHECK(exclude_kernel_fallback(attr, core.uncore(), EACCES, 2));
+    CHECK(attr.exclude_kernel);
+    CHECK(!exclude_kernel_fallback(attr, core.uncore(), EACCES, 2));
+
+    // ... and only if the paranoid setting is the reason for the failure
+    attr = empty_attr();
+    CHECK(!exclude_kernel_fallback(attr, core.uncore(), EACCES, 1));
+    CHECK(!exclude_kernel_fallback(attr, core.uncore(), EINVAL, 2));
+    CHECK(!excludes_anything(attr));
+
+    for (int paranoid = -1; paranoid <= 3; paranoid++)
+    {
+        for (int error : { EACCES, EPERM, EINVAL, ENOENT })
+        {
+            attr = empty_attr();
+            CHECK(!exclude_kernel_fallback(attr, uncore.uncore(), error, paranoid));
+            CHECK(!excludes_anything(attr));
+        }
+    }
+
+    return lo2s::test::result();
+}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Replays LBR call stacks as the kernel records them and checks the call stacks that are built
+ * for the calling context tree.
+ */
+
+#include "check.hpp"
+
+#include <lo2s/perf/sample/lbr_call_stack.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+using lo2s::perf::sample::lbr_call_stack;
+
+namespace
+{
+struct perf_branch_entry branch(uint64_t from, uint64_t to)
+{
+    struct perf_branch_entry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.from = from;
+    entry.to = to;
+    return entry;
+}
+} // namespace
+
+int main()
+{
+    // main (0x1000) calls foo (0x2000) at 0x1010, foo calls bar (0x3000) at 0x2020, and the sample
+    // hits bar at 0x3030. The LBR call stack holds the active calls, innermost first.
+    const uint64_t ip = 0x3030;
+    const std::vector<struct perf_branch_entry> entries = { branch(0x2020, 0x3000),
+                                                            branch(0x1010, 0x2000) };
+
+    std::vector<uint64_t> frames;
+    lbr_call_stack(ip, entries.data(), entries.size(), frames);
+    CHECK(frames == (std::vector<uint64_t>{ 0x3030, 0x2020, 0x1010 }));
+
+    // The calling context tree is built from the outermost frame: main, foo, bar
+    const std::vector<uint64_t> path(frames.rbegin(), frames.rend());
+    CHECK(path == (std::vector<uint64_t>{ 0x1010, 0x2020, 0x3030 }));
+
+    // The frames are reused for the next sample, which may have a shallower stack
+    lbr_call_stack(0x2040, entries.data() + 1, 1, frames);
+    CHECK(frames == (std::vector<uint64_t>{ 0x2040, 0x1010 }));
+
+    // A sample in the outermost function has no active calls on the LBR
+    lbr_call_stack(0x1020, nullptr, 0, frames);
+    CHECK(frames == (std::vector<uint64_t>{ 0x1020 }));
+
+    return lo2s::test::result();
+}
@@ -0,0 +1,206 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Pushes records with out of order timestamps through the reorder window and checks the order in
+ * which they are released.
+ */
+
+#include "check.hpp"
+
+#include <lo2s/perf/reorder_buffer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+extern "C"
+{
+#include <linux/perf_event.h>
+}
+
+using lo2s::perf::ReorderBuffer;
+
+namespace
+{
+struct Record
+{
+    struct perf_event_header header;
+    std::uint64_t time;
+    std::uint64_t id;
+};
+
+// Stands in for the ring buffer, the records never move
+class Records
+{
+public:
+    const perf_event_header* add(std::uint64_t time, std::uint64_t id = 0)
+    {
+        Record record;
+        std::memset(&record, 0, sizeof(record));
+        record.header.size = sizeof(record);
+        record.time = time;
+        record.id = id;
+        records_.push_back(record);
+        return &records_.back().header;
+    }
+
+    void push(ReorderBuffer& buffer, std::uint64_t time, std::uint64_t id = 0)
+    {
+        buffer.push(time, add(time, id), released_);
+    }
+
+    void flush(ReorderBuffer& buffer)
+    {
+        buffer.flush(released_);
+    }
+
+    void clobber()
+    {
+        for (auto& record : records_)
+        {
+            std::memset(&record, 0xff, sizeof(record));
+        }
+    }
+
+    std::vector<std::uint64_t> times() const
+    {
+        return released_.times;
+    }
+
+    std::vector<std::uint64_t> ids() const
+    {
+        return released_.ids;
+    }
+
+private:
+    struct Released
+    {
+        void operator()(const perf_event_header* header)
+        {
+            auto record = reinterpret_cast<const Record*>(header);
+            times.push_back(record->time);
+            ids.push_back(record->id);
+        }
+
+        std::vector<std::uint64_t> times;
+        std::vector<std::uint64_t> ids;
+    };
+
+    std::deque<Record> records_;
+    Released released_;
+};
+
+using Times = std::vector<std::uint64_t>;
+} // namespace
+
+int main()
+{
+    const std::chrono::nanoseconds horizon(100);
+
+    {
+        // Records within the horizon are sorted
+        ReorderBuffer buffer(horizon, 16);
+        Records records;
+        records.push(buffer, 10);
+        records.push(buffer, 30);
+        records.push(buffer, 20);
+        CHECK(records.times().empty());
+        records.flush(buffer);
+        CHECK((records.times() == Times{ 10, 20, 30 }));
+        CHECK(buffer.late() == 0);
+        CHECK(buffer.overflows() == 0);
+    }
+
+    {
+        // Records leave the window once they are older than the newest one minus the horizon
+        ReorderBuffer buffer(horizon, 16);
+        Records records;
+        records.push(buffer, 10);
+        records.push(buffer, 200);
+        CHECK((records.times() == Times{ 10 }));
+        records.push(buffer, 150);
+        records.push(buffer, 300);
+        CHECK((records.times() == Times{ 10, 150 }));
+        records.flush(buffer);
+        CHECK((records.times() == Times{ 10, 150, 200, 300 }));
+    }
+
+    {
+        // Records with equal timestamps keep the order they were read in
+        ReorderBuffer buffer(horizon, 16);
+        Records records;
+        records.push(buffer, 50, 1);
+        records.push(buffer, 40, 0);
+        records.push(buffer, 50, 2);
+        records.push(buffer, 50, 3);
+        records.flush(buffer);
+        CHECK((records.ids() == Times{ 0, 1, 2, 3 }));
+    }
+
+    {
+        // A full window releases its oldest record
+        ReorderBuffer buffer(horizon, 2);
+        Records records;
+        records.push(buffer, 30);
+        records.push(buffer, 10);
+        records.push(buffer, 20);
+        CHECK(buffer.overflows() == 1);
+        CHECK((records.times() == Times{ 10 }));
+        records.flush(buffer);
+        CHECK((records.times() == Times{ 10, 20, 30 }));
+    }
+
+    {
+        // Records older than one that was released already are counted as late, also after a
+        // late record has been released
+        ReorderBuffer buffer(horizon, 16);
+        Records records;
+        records.push(buffer, 10);
+        records.push(buffer, 300);
+        records.push(buffer, 5);
+        CHECK(buffer.late() == 1);
+        CHECK((records.times() == Times{ 10, 5 }));
+        records.push(buffer, 7);
+        CHECK(buffer.late() == 2);
+        records.flush(buffer);
+
+        // Including those that would leave the window right away
+        records.push(buffer, 250);
+        CHECK(buffer.late() == 3);
+    }
+
+    {
+        // Records still held when the ring buffer is handed back are copied
+        ReorderBuffer buffer(horizon, 16);
+        Records records;
+        records.push(buffer, 20, 2);
+        records.push(buffer, 10, 1);
+        buffer.copy_pending();
+        records.clobber();
+        records.flush(buffer);
+        CHECK((records.times() == Times{ 10, 20 }));
+        CHECK((records.ids() == Times{ 1, 2 }));
+    }
+
+    return lo2s::test::result();
+}
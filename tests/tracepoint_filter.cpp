@@ -0,0 +1,125 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Splits tracepoint specs as given to -t and checks the field names of their filters, without
+ * reading the tracepoint formats from tracefs.
+ */
+
+#include "check.hpp"
+
+#include <lo2s/perf/tracepoint/format.hpp>
+
+#include <string>
+#include <vector>
+
+using lo2s::perf::tracepoint::EventField;
+using lo2s::perf::tracepoint::EventSpec;
+using lo2s::perf::tracepoint::InvalidFilter;
+
+namespace
+{
+bool spec_is(const std::string& spec, const std::string& name, const std::string& filter)
+{
+    EventSpec parsed(spec);
+    return parsed.name == name && parsed.filter == filter;
+}
+
+bool invalid_spec(const std::string& spec)
+{
+    try
+    {
+        EventSpec parsed(spec);
+    }
+    catch (const InvalidFilter&)
+    {
+        return true;
+    }
+    return false;
+}
+
+// The fields of sched:sched_switch, in parts
+const std::vector<EventField> fields = { EventField("prev_comm", 8, 16),
+                                         EventField("prev_pid", 24, 4),
+                                         EventField("prev_state", 32, 8),
+                                         EventField("next_pid", 56, 4) };
+const std::vector<EventField> common_fields = { EventField("common_type", 0, 2),
+                                                EventField("common_pid", 4, 4) };
+
+bool valid_filter(const std::string& filter)
+{
+    try
+    {
+        lo2s::perf::tracepoint::validate_filter("sched/sched_switch", filter, fields,
+                                                common_fields);
+    }
+    catch (const InvalidFilter&)
+    {
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int main()
+{
+    // Spec splitting
+    CHECK(spec_is("sched:sched_switch", "sched:sched_switch", ""));
+    CHECK(spec_is("sched/sched_switch", "sched/sched_switch", ""));
+    CHECK(spec_is("sched:sched_switch/prev_pid==1/", "sched:sched_switch", "prev_pid==1"));
+    CHECK(spec_is("sched/sched_switch/prev_pid==1/", "sched/sched_switch", "prev_pid==1"));
+    // Only the first '/' after the separator starts the filter
+    CHECK(spec_is("sched:sched_switch/prev_comm==\"a/b\"/", "sched:sched_switch",
+                  "prev_comm==\"a/b\""));
+    CHECK(invalid_spec("sched:sched_switch/prev_pid==1"));
+    CHECK(invalid_spec("sched:sched_switch/"));
+    CHECK(invalid_spec("sched:sched_switch//"));
+    CHECK(invalid_spec("sched/sched_switch//"));
+
+    // Field names
+    CHECK(valid_filter("prev_pid==1"));
+    CHECK(valid_filter("prev_pid == 1 && next_pid != 2"));
+    CHECK(valid_filter("prev_pid<10||next_pid>=20"));
+    CHECK(valid_filter("prev_state & 1"));
+    CHECK(valid_filter("prev_state&1&&next_pid==2"));
+    CHECK(!valid_filter("prev_stat & 1"));
+    CHECK(!valid_filter("pid==1"));
+    CHECK(!valid_filter("prev_pid==1 && pid==2"));
+
+    // common_* fields may be compared, but are not listed
+    CHECK(valid_filter("common_pid==1"));
+    CHECK(!valid_filter("common_foo==1"));
+
+    // As may the fields that the kernel provides for every event
+    CHECK(valid_filter("common_cpu==1"));
+    CHECK(valid_filter("cpu==1 || CPU==2"));
+    CHECK(valid_filter("comm==\"foo\""));
+
+    // String constants are skipped, even if they look like a predicate
+    CHECK(valid_filter("prev_comm==\"foo\""));
+    CHECK(valid_filter("prev_comm~\"bar==1 && baz\""));
+    CHECK(valid_filter("prev_comm == \"a\" && next_pid == 1"));
+
+    // A filter has to compare at least one field
+    CHECK(!valid_filter("1"));
+    CHECK(!valid_filter("\"prev_pid==1\""));
+
+    return lo2s::test::result();
+}
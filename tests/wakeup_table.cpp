@@ -0,0 +1,100 @@
+/*
+ * This file is part of the lo2s software.
+ * Linux OTF2 sampling
+ *
+ * Copyright (c) 2020,
+ *    Technische Universitaet Dresden, Germany
+ *
+ * lo2s is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * lo2s is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with lo2s.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Replays the scheduler tracepoints of a few threads in the orders in which the writers of
+ * different CPUs may read them, and checks which runqueue latencies are paired.
+ */
+
+#include "check.hpp"
+
+#include <lo2s/perf/tracepoint/wakeup_table.hpp>
+
+#include <cstdint>
+
+using lo2s::perf::tracepoint::WakeupTable;
+
+int main()
+{
+    const uint64_t forget_after = WakeupTable::forget_after;
+
+    {
+        // Wakeup before the switch-in
+        WakeupTable table;
+        CHECK(table.wakeup(1, 100) == -1);
+        CHECK(table.switch_in(1, 150) == 50);
+        // Every wakeup is only paired once
+        table.switch_out(1, 200);
+        CHECK(table.switch_in(1, 300) == -1);
+    }
+
+    {
+        // The switch-in is read before its wakeup, which was recorded on another CPU
+        WakeupTable table;
+        CHECK(table.switch_in(2, 200) == -1);
+        CHECK(table.wakeup(2, 180) == 20);
+        CHECK(table.wakeup(2, 190) == -1);
+        // A wakeup from before the switch that preceded the switch-in belongs to an earlier run
+        table.switch_out(2, 300);
+        CHECK(table.switch_in(2, 400) == -1);
+        CHECK(table.wakeup(2, 250) == -1);
+    }
+
+    {
+        // A stale wakeup, read after the thread was switched out again, is dropped
+        WakeupTable table;
+        CHECK(table.wakeup(3, 100) == -1);
+        CHECK(table.switch_in(3, 110) == 10);
+        table.switch_out(3, 200);
+        CHECK(table.wakeup(3, 150) == -1);
+        CHECK(table.switch_in(3, 300) == -1);
+    }
+
+    {
+        // A wakeup while the thread is still running is consumed by its switch-out
+        WakeupTable table;
+        CHECK(table.switch_in(4, 100) == -1);
+        CHECK(table.wakeup(4, 150) == -1);
+        table.switch_out(4, 200);
+        CHECK(table.switch_in(4, 300) == -1);
+    }
+
+    {
+        // Threads that have not been seen for forget_after are removed, 5 and 69 share a shard
+        WakeupTable table;
+        CHECK(table.wakeup(5, 1000) == -1);
+        CHECK(table.switch_in(5, 1100) == 100);
+        CHECK(table.size() == 1);
+
+        CHECK(table.switch_in(69, 1101 + forget_after) == -1);
+        CHECK(table.size() == 1);
+
+        // Wakeups older than forget_after are not even looked up
+        CHECK(table.wakeup(5, 1000) == -1);
+        CHECK(table.size() == 1);
+
+        // Recent threads are kept
+        CHECK(table.wakeup(69, 1200 + forget_after) == -1);
+        CHECK(table.switch_in(69, 1300 + forget_after) == 100);
+        CHECK(table.size() == 1);
+    }
+
+    return lo2s::test::result();
+}